@@ -0,0 +1,61 @@
+/*
+* Paul Fulham
+*/
+
+#include "bigaccumulator.h"
+
+BigAccumulator::BigAccumulator()
+{
+}
+
+BigAccumulator & BigAccumulator::operator+=(const BigIntegerView & value)
+{
+	addWords(value.signum(), value);
+	return *this;
+}
+
+BigAccumulator & BigAccumulator::operator-=(const BigIntegerView & value)
+{
+	addWords(-value.signum(), value);
+	return *this;
+}
+
+BigAccumulator & BigAccumulator::operator+=(const BigAccumulator & other)
+{
+	this->positive.add(other.positive);
+	this->negative.add(other.negative);
+	return *this;
+}
+
+BigInteger BigAccumulator::value() const
+{
+	std::vector<int32_t> mag = this->positive.magnitude(), n = this->negative.magnitude();
+	int sign = BigInteger::accumulate(mag, mag.empty() ? 0 : 1, n.data(), n.size(), n.empty() ? 0 : -1);
+	BigInteger::trimLeadingZeroInts(mag);
+	if (mag.empty())
+	{
+		return 0;
+	}
+	return BigInteger(sign, std::move(mag));
+}
+
+void BigAccumulator::clear()
+{
+	this->positive = BigInteger::Columns();
+	this->negative = BigInteger::Columns();
+}
+
+void BigAccumulator::addWord(bool negative, uint64_t magnitude)
+{
+	BigInteger::Columns * sides[] = { &this->positive, &this->negative };
+	sides[negative]->add(magnitude);
+}
+
+void BigAccumulator::addWords(int sign, const BigIntegerView & value)
+{
+	if (sign != 0)
+	{
+		BigInteger::Scratch::Frame frame;
+		(sign > 0 ? this->positive : this->negative).add(value.bigEndian(frame), value.length());
+	}
+}
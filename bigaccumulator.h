@@ -0,0 +1,62 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include "bigintegerview.h"
+
+// A running total for adding very many values. Positive and negative
+// addends go into separate 64 bit columns, one per word, whose carries are
+// held back until a column could overflow, so an addend never ripples a
+// carry, compares magnitudes or trims its result: an integer costs two
+// column additions, and a BigInteger one per word. The carries are moved
+// and the two sides subtracted only when the total is read
+class BigAccumulator
+{
+public:
+	BigAccumulator();
+
+	// The signs of a stream of integers are often as good as random, so
+	// neither taking the magnitude nor choosing the side branches on them;
+	// zero adds nothing to whichever side it lands on
+
+	template <typename T, typename W = BigInteger::Word<T>>
+	BigAccumulator & operator+=(T value)
+	{
+		uint64_t mask = 0 - (uint64_t)(std::is_signed<T>::value && value < 0);
+		addWord(mask != 0, ((uint64_t)(W)value ^ mask) - mask);
+		return *this;
+	}
+
+	template <typename T, typename W = BigInteger::Word<T>>
+	BigAccumulator & operator-=(T value)
+	{
+		uint64_t mask = 0 - (uint64_t)(std::is_signed<T>::value && value < 0);
+		addWord(mask == 0, ((uint64_t)(W)value ^ mask) - mask);
+		return *this;
+	}
+
+	BigAccumulator & operator+=(const BigIntegerView & value);
+
+	BigAccumulator & operator-=(const BigIntegerView & value);
+
+	// takes in everything other has taken, as when totals kept on separate
+	// threads are brought together
+	BigAccumulator & operator+=(const BigAccumulator & other);
+
+	BigInteger value() const;
+
+	void clear();
+
+private:
+	// moving carries changes how the total is held, not its value, so
+	// reading it may do so
+	mutable BigInteger::Columns positive;
+
+	mutable BigInteger::Columns negative;
+
+	void addWord(bool negative, uint64_t magnitude);
+
+	void addWords(int sign, const BigIntegerView & value);
+};
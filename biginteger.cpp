@@ -2,88 +2,164 @@
 * Paul Fulham
 */
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <exception>
 #include <utility>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #include "biginteger.h"
+#include "limbkernels.h"
+#include "threadpool.h"
 
-const std::vector<std::vector<BigInteger>> BigInteger::POWER_CACHE = [] {
-	std::vector<std::vector<BigInteger>> powerCache(MAX_RADIX + 1);
-	for (auto i = MIN_RADIX; i <= MAX_RADIX; i++)
+constexpr double BigInteger::LOG_CACHE[];
+
+constexpr double BigInteger::LOG_TWO;
+
+constexpr int BigInteger::DIGITS_PER_LONG[];
+
+constexpr int BigInteger::EXP_MOD_THRESHOLDS[];
+
+constexpr uint64_t BigInteger::LONG_RADIX[];
+
+constexpr int BigInteger::DIGITS_PER_INT[];
+
+constexpr int BigInteger::INT_RADIX[];
+
+constexpr size_t BigInteger::BITS_PER_DIGIT[];
+
+#if defined(BIGINTEGER_STATS)
+
+const bool BigInteger::Stats::ENABLED = true;
+
+static const size_t STATS_COUNTERS = 2 * BigInteger::Stats::PATH_COUNT + 2;
+
+// Each thread counts into its own block, which only it writes, so the hot
+// paths never contend; a snapshot sums the live blocks with whatever
+// exited threads left behind, and a reset only moves the baseline
+struct StatsRegistry
+{
+	std::mutex lock;
+
+	std::vector<const std::atomic<uint64_t> *> blocks;
+
+	uint64_t retired[STATS_COUNTERS] = {};
+
+	uint64_t baseline[STATS_COUNTERS] = {};
+};
+
+static StatsRegistry & statsRegistry()
+{
+	static StatsRegistry registry;
+	return registry;
+}
+
+struct StatsBlock
+{
+	std::atomic<uint64_t> counters[STATS_COUNTERS];
+
+	StatsBlock()
 	{
-		powerCache[i].push_back(BigInteger(i));
+		for (auto & counter : this->counters)
+		{
+			counter.store(0, std::memory_order_relaxed);
+		}
+		StatsRegistry & registry = statsRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		registry.blocks.push_back(this->counters);
 	}
-	return powerCache;
-}();
 
-const std::vector<double> BigInteger::LOG_CACHE = [] {
-	std::vector<double> logCache(MAX_RADIX + 1);
-	for (auto i = MIN_RADIX; i <= MAX_RADIX; i++)
+	~StatsBlock()
 	{
-		logCache[i] = std::log(i);
+		StatsRegistry & registry = statsRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		for (size_t i = 0; i < STATS_COUNTERS; i++)
+		{
+			registry.retired[i] += this->counters[i].load(std::memory_order_relaxed);
+		}
+		registry.blocks.erase(std::find(registry.blocks.begin(), registry.blocks.end(), this->counters));
 	}
-	return logCache;
-}();
-
-const double BigInteger::LOG_TWO = std::log(2.0);
-
-const int BigInteger::DIGITS_PER_LONG[] = { 0, 0,
-	62, 39, 31, 27, 24, 22, 20, 19, 18, 18, 17, 17, 16, 16, 15, 15, 15, 14,
-	14, 14, 14, 13, 13, 13, 13, 13, 13, 12, 12, 12, 12, 12, 12, 12, 12
-};
 
-const BigInteger BigInteger::LONG_RADIX[] = { 0, 0,
-	BigInteger(0x4000000000000000), BigInteger(0x383d9170b85ff80b),
-	BigInteger(0x4000000000000000), BigInteger(0x6765c793fa10079d),
-	BigInteger(0x41c21cb8e1000000), BigInteger(0x3642798750226111),
-	BigInteger(0x1000000000000000), BigInteger(0x12bf307ae81ffd59),
-	BigInteger( 0xde0b6b3a7640000), BigInteger(0x4d28cb56c33fa539),
-	BigInteger(0x1eca170c00000000), BigInteger(0x780c7372621bd74d),
-	BigInteger(0x1e39a5057d810000), BigInteger(0x5b27ac993df97701),
-	BigInteger(0x1000000000000000), BigInteger(0x27b95e997e21d9f1),
-	BigInteger(0x5da0e1e53c5c8000), BigInteger( 0xb16a458ef403f19),
-	BigInteger(0x16bcc41e90000000), BigInteger(0x2d04b7fdd9c0ef49),
-	BigInteger(0x5658597bcaa24000), BigInteger( 0x6feb266931a75b7),
-	BigInteger( 0xc29e98000000000), BigInteger(0x14adf4b7320334b9),
-	BigInteger(0x226ed36478bfa000), BigInteger(0x383d9170b85ff80b),
-	BigInteger(0x5a3c23e39c000000), BigInteger( 0x4e900abb53e6b71),
-	BigInteger( 0x7600ec618141000), BigInteger( 0xaee5720ee830681),
-	BigInteger(0x1000000000000000), BigInteger(0x172588ad4f5f0981),
-	BigInteger(0x211e44f7d02c1000), BigInteger(0x2ee56725f06e5c71),
-	BigInteger(0x41c21cb8e1000000)
+	void add(size_t counter, uint64_t n)
+	{
+		// a single writer needs no read-modify-write
+		std::atomic<uint64_t> & c = this->counters[counter];
+		c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
 };
 
-const int BigInteger::DIGITS_PER_INT[] = { 0, 0,
-	30, 19, 15, 13, 11, 11, 10, 9, 9, 8, 8, 8, 8, 7, 7, 7, 7, 7,
-	7, 7, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 5
-};
+static thread_local StatsBlock localStats;
 
-const int BigInteger::INT_RADIX[] = { 0, 0,
-	0x40000000, 0x4546b3db, 0x40000000, 0x48c27395, 0x159fd800,
-	0x75db9c97, 0x40000000, 0x17179149, 0x3b9aca00 , 0xcc6db61,
-	0x19a10000, 0x309f1021, 0x57f6c100,  0xa2f1b6f, 0x10000000,
-	0x18754571, 0x247dbc80, 0x3547667b, 0x4c4b4000, 0x6b5a6e1d,
-	 0x6c20a40,  0x8d2d931,  0xb640000,  0xe8d4a51, 0x1269ae40,
-	0x17179149, 0x1cb91000, 0x23744899, 0x2b73a840, 0x34e63b41,
-	0x40000000, 0x4cfa3cc1, 0x5c13d840, 0x6d91b519,  0x39aa400
-};
+static void countPath(BigInteger::Stats::Path path, size_t words)
+{
+	localStats.add(path, 1);
+	localStats.add(BigInteger::Stats::PATH_COUNT + path, words);
+}
 
-const std::vector<std::string> BigInteger::ZEROES = [] {
-	std::vector<std::string> zeroes(64);
-	zeroes[63] = "000000000000000000000000000000000000000000000000000000000000000";
-	for (auto i = 0; i < 63; i++)
+static void countMagnitude(const std::vector<int32_t> & mag)
+{
+	if (mag.capacity() != 0)
 	{
-		zeroes[i] = zeroes[63].substr(0, i);
+		localStats.add(2 * BigInteger::Stats::PATH_COUNT, 1);
+		localStats.add(2 * BigInteger::Stats::PATH_COUNT + 1, mag.capacity() * sizeof(int32_t));
 	}
-	return zeroes;
-}();
+}
 
-const size_t BigInteger::BITS_PER_DIGIT[] = { 0, 0,
-	1024, 1624, 2048, 2378, 2648, 2875, 3072, 3247, 3402, 3543, 3672,
-	3790, 3899, 4001, 4096, 4186, 4271, 4350, 4426, 4498, 4567, 4633,
-	4696, 4756, 4814, 4870, 4923, 4975, 5025, 5074, 5120, 5166, 5210,
-	5253, 5295
-};
+#define COUNT_PATH(path, words) countPath(BigInteger::Stats::path, words)
+#define COUNT_MAGNITUDE(mag) countMagnitude(mag)
+
+#else
+
+const bool BigInteger::Stats::ENABLED = false;
+
+#define COUNT_PATH(path, words)
+#define COUNT_MAGNITUDE(mag)
+
+#endif
+
+BigInteger::Scratch & BigInteger::Scratch::local()
+{
+	static thread_local Scratch scratch;
+	return scratch;
+}
+
+BigInteger::Scratch::Frame::Frame() :
+	scratch(local()),
+	block(scratch.block),
+	used(scratch.used)
+{
+}
+
+BigInteger::Scratch::Frame::~Frame()
+{
+	this->scratch.block = this->block;
+	this->scratch.used = this->used;
+}
+
+int32_t * BigInteger::Scratch::Frame::take(size_t len)
+{
+	Scratch & s = this->scratch;
+	// words that do not fit the current block come from the next block big
+	// enough, and past the last one from a new block at least twice as big
+	while (s.block < s.blocks.size() && s.used + len > s.sizes[s.block])
+	{
+		s.block++;
+		s.used = 0;
+	}
+	if (s.block == s.blocks.size())
+	{
+		size_t size = std::max(len, s.sizes.empty() ? (size_t)1024 : 2 * s.sizes.back());
+		s.blocks.emplace_back(new int32_t[size]);
+		s.sizes.push_back(size);
+	}
+	int32_t * words = s.blocks[s.block].get() + s.used;
+	s.used += len;
+	std::fill(words, words + len, 0);
+	return words;
+}
 
 BigInteger::BigInteger(int64_t val)
 {
@@ -93,21 +169,24 @@ BigInteger::BigInteger(int64_t val)
 	}
 	else
 	{
+		uint64_t magnitude = (uint64_t)val;
 		if (val < 0)
 		{
-			val = -val;
+			magnitude = 0 - magnitude;
 			this->signum = -1;
 		}
 		else
 		{
 			this->signum = 1;
 		}
-		int32_t highWord = (int32_t)((uint64_t)val >> 32);
+		int32_t highWord = (int32_t)(magnitude >> 32);
+		std::vector<int32_t> & m = this->mag.edit();
 		if (highWord != 0)
 		{
-			this->mag.push_back(highWord);
+			m.push_back(highWord);
 		}
-		this->mag.push_back((int32_t)val);
+		m.push_back((int32_t)magnitude);
+		COUNT_MAGNITUDE(this->mag);
 	}
 }
 
@@ -193,6 +272,7 @@ BigInteger::BigInteger(std::string val, int radix)
 		destructiveMulAdd(magnitude, superRadix, groupVal);
 	}
 	this->mag = stripLeadingZeroInts(magnitude);
+	COUNT_MAGNITUDE(this->mag);
 }
 
 BigInteger::BigInteger(std::vector<int32_t> & val)
@@ -211,12 +291,20 @@ BigInteger::BigInteger(std::vector<int32_t> & val)
 		this->mag = stripLeadingZeroInts(val);
 		this->signum = mag.size() == 0 ? 0 : 1;
 	}
+	COUNT_MAGNITUDE(this->mag);
 }
 
 BigInteger::BigInteger(int signum, std::vector<int32_t> magnitude)
 {
 	this->signum = magnitude.size() == 0 ? 0 : signum;
-	this->mag = magnitude;
+	this->mag = std::move(magnitude);
+	COUNT_MAGNITUDE(this->mag);
+}
+
+BigInteger::BigInteger(int signum, const Magnitude & magnitude) :
+	signum(magnitude.size() == 0 ? 0 : signum),
+	mag(magnitude)
+{
 }
 
 BigInteger BigInteger::withSign(int sign) const
@@ -226,10 +314,6 @@ BigInteger BigInteger::withSign(int sign) const
 
 int32_t BigInteger::getInt(size_t n) const
 {
-	if (n < 0)
-	{
-		return 0;
-	}
 	if (n >= this->mag.size())
 	{
 		return this->signum < 0 ? -1 : 0;
@@ -241,14 +325,42 @@ int32_t BigInteger::getInt(size_t n) const
 	}
 	size_t i;
 	size_t mlen = this->mag.size();
-	for (i = mlen - 1; i >= 0 && this->mag[i] == 0; i--);
+	for (i = mlen - 1; this->mag[i] == 0; i--);
 	if (n <= mlen - i - 1)
 	{
-		return -magInt;
+		return (int32_t)(0 - (uint32_t)magInt);
 	}
 	return ~magInt;
 }
 
+BigInteger BigInteger::getLower(size_t n) const
+{
+	return getBlock(0, n);
+}
+
+BigInteger BigInteger::getUpper(size_t n) const
+{
+	if (n >= this->mag.size())
+	{
+		return 0;
+	}
+	return BigInteger(1, std::vector<int32_t>(this->mag.begin(), this->mag.end() - n));
+}
+
+BigInteger BigInteger::getBlock(size_t index, size_t length) const
+{
+	// words of the magnitude, counted in blocks from the least significant end
+	size_t len = this->mag.size();
+	if (index * length >= len)
+	{
+		return 0;
+	}
+	size_t end = len - index * length;
+	size_t start = end > length ? end - length : 0;
+	std::vector<int32_t> block(this->mag.begin() + start, this->mag.begin() + end);
+	return BigInteger(1, stripLeadingZeroInts(block));
+}
+
 int BigInteger::getLowestSetBit() const
 {
 	if (this->mag.size() == 0)
@@ -265,6 +377,16 @@ int BigInteger::getLowestSetBit() const
 	return ((this->mag.size() - 1 - j) << 5) + numberOfTrailingZeroes(b);
 }
 
+int BigInteger::bitWindow(size_t from, int width) const
+{
+	int value = 0;
+	for (int k = width; k-- > 0; )
+	{
+		value = (value << 1) | (testBit((int32_t)(from + k)) ? 1 : 0);
+	}
+	return value;
+}
+
 bool BigInteger::operator<(const BigInteger & rhs) const
 {
 	return compare(rhs) < 0;
@@ -332,7 +454,7 @@ BigInteger BigInteger::operator-(const BigInteger & rhs) const
 	}
 	if (this->signum == 0)
 	{
-		return -*this;
+		return -rhs;
 	}
 	if (rhs.signum != this->signum)
 	{
@@ -365,6 +487,10 @@ BigInteger BigInteger::operator*(const BigInteger & rhs) const
 	{
 		return multiplyByInt(rhs.mag, this->mag[0], resultSign);
 	}
+	if (xlen >= KARATSUBA_THRESHOLD && ylen >= KARATSUBA_THRESHOLD)
+	{
+		return multiplyKaratsuba(*this, rhs).withSign(resultSign);
+	}
 	std::vector<int32_t> result = multiplyToLen(this->mag, xlen, rhs.mag, ylen);
 	result = stripLeadingZeroInts(result);
 	return BigInteger(resultSign, result);
@@ -379,6 +505,10 @@ BigInteger BigInteger::operator/(const BigInteger & rhs) const
 
 BigInteger BigInteger::operator%(const BigInteger & rhs) const
 {
+	if (rhs.mag.size() == 1 || rhs.mag.size() == 2)
+	{
+		return valueOf(this->signum, remainderWord(rhs.wordMagnitude()));
+	}
 	BigInteger q;
 	return divide(rhs, q);
 }
@@ -417,148 +547,931 @@ BigInteger BigInteger::operator>>(int32_t n) const
 	return BigInteger(this->signum, shiftLeft(this->mag, -n));
 }
 
+BigInteger BigInteger::operator&(const BigInteger & rhs) const
+{
+	// A negative operand x is handled through ~x = |x| - 1, which is
+	// non-negative, so only magnitudes are ever combined
+	if (this->signum >= 0 && rhs.signum >= 0)
+	{
+		return BigInteger(1, stripLeadingZeroInts(andMagnitude(this->mag, rhs.mag)));
+	}
+	if (this->signum >= 0)
+	{
+		return BigInteger(1, stripLeadingZeroInts(andNotMagnitude(this->mag, (~rhs).mag)));
+	}
+	if (rhs.signum >= 0)
+	{
+		return BigInteger(1, stripLeadingZeroInts(andNotMagnitude(rhs.mag, (~*this).mag)));
+	}
+	return ~BigInteger(1, orMagnitude((~*this).mag, (~rhs).mag));
+}
+
+BigInteger BigInteger::operator|(const BigInteger & rhs) const
+{
+	if (this->signum >= 0 && rhs.signum >= 0)
+	{
+		return BigInteger(1, orMagnitude(this->mag, rhs.mag));
+	}
+	if (this->signum >= 0)
+	{
+		return ~BigInteger(1, stripLeadingZeroInts(andNotMagnitude((~rhs).mag, this->mag)));
+	}
+	if (rhs.signum >= 0)
+	{
+		return ~BigInteger(1, stripLeadingZeroInts(andNotMagnitude((~*this).mag, rhs.mag)));
+	}
+	return ~BigInteger(1, stripLeadingZeroInts(andMagnitude((~*this).mag, (~rhs).mag)));
+}
+
+BigInteger BigInteger::operator^(const BigInteger & rhs) const
+{
+	if (this->signum >= 0 && rhs.signum >= 0)
+	{
+		return BigInteger(1, stripLeadingZeroInts(xorMagnitude(this->mag, rhs.mag)));
+	}
+	if (this->signum >= 0)
+	{
+		return ~BigInteger(1, stripLeadingZeroInts(xorMagnitude(this->mag, (~rhs).mag)));
+	}
+	if (rhs.signum >= 0)
+	{
+		return ~BigInteger(1, stripLeadingZeroInts(xorMagnitude((~*this).mag, rhs.mag)));
+	}
+	return BigInteger(1, stripLeadingZeroInts(xorMagnitude((~*this).mag, (~rhs).mag)));
+}
+
+BigInteger BigInteger::operator~() const
+{
+	return -*this - 1;
+}
+
 BigInteger & BigInteger::operator=(BigInteger rhs)
 {
 	std::swap(this->signum, rhs.signum);
-	std::swap(this->mag, rhs.mag);
+	this->mag.swap(rhs.mag);
 	return *this;
 }
 
+BigInteger & BigInteger::operator+=(const BigInteger & rhs)
+{
+	return *this = *this + rhs;
+}
+
+BigInteger & BigInteger::operator-=(const BigInteger & rhs)
+{
+	return *this = *this - rhs;
+}
+
+BigInteger & BigInteger::operator*=(const BigInteger & rhs)
+{
+	return *this = *this * rhs;
+}
+
+BigInteger & BigInteger::operator/=(const BigInteger & rhs)
+{
+	return *this = *this / rhs;
+}
+
+BigInteger & BigInteger::operator%=(const BigInteger & rhs)
+{
+	return *this = *this % rhs;
+}
+
 BigInteger BigInteger::abs() const
 {
 	return this->signum >= 0 ? *this : -*this;
 }
 
-BigInteger BigInteger::divide(const BigInteger & val, BigInteger & quotient) const
+BigInteger BigInteger::andNot(const BigInteger & val) const
 {
-	BigInteger r = divideKnuth(val, quotient);
-	quotient = quotient.withSign(this->signum == val.signum ? 1 : -1);
-	return r.withSign(this->signum);
+	if (val.signum < 0)
+	{
+		return *this & ~val;
+	}
+	if (this->signum >= 0)
+	{
+		return BigInteger(1, stripLeadingZeroInts(andNotMagnitude(this->mag, val.mag)));
+	}
+	return ~BigInteger(1, orMagnitude((~*this).mag, val.mag));
 }
 
-std::string BigInteger::toString() const
+bool BigInteger::testBit(int32_t n) const
 {
-	return toString(10);
+	if (n < 0)
+	{
+		throw "Negative bit address";
+	}
+	return (getInt((uint32_t)n >> 5) & (1 << (n & 31))) != 0;
 }
 
-std::string BigInteger::toString(int radix) const
+BigInteger BigInteger::setBit(int32_t n) const
 {
-	if (this->signum == 0)
+	if (n < 0)
 	{
-		return "0";
+		throw "Negative bit address";
 	}
-	if (radix < MIN_RADIX || radix > MAX_RADIX)
+	if (this->signum < 0)
 	{
-		radix = 10;
+		return ~(~*this).clearBit(n);
 	}
-	if (this->mag.size() < SCHOENHAGE_BASE_CONVERSION_THRESHOLD)
+	std::vector<int32_t> result = widenToBit(this->mag, n);
+	result[result.size() - ((uint32_t)n >> 5) - 1] |= 1 << (n & 31);
+	return BigInteger(1, result);
+}
+
+BigInteger BigInteger::clearBit(int32_t n) const
+{
+	if (n < 0)
 	{
-		return smallToString(radix);
+		throw "Negative bit address";
 	}
-	std::string sb;
 	if (this->signum < 0)
 	{
-		toString(-*this, sb, radix, 0);
-		sb.insert(0, "-");
+		return ~(~*this).setBit(n);
 	}
-	else
+	if (((uint32_t)n >> 5) >= this->mag.size())
 	{
-		toString(*this, sb, radix, 0);
+		return *this;
 	}
-	return sb;
+	std::vector<int32_t> result = this->mag;
+	result[result.size() - ((uint32_t)n >> 5) - 1] &= ~(1 << (n & 31));
+	return BigInteger(1, stripLeadingZeroInts(result));
 }
 
-int64_t BigInteger::longValue() const
+BigInteger BigInteger::flipBit(int32_t n) const
 {
-	int64_t result = 0;
-	for (size_t i = 2; i-- > 0; )
+	if (n < 0)
 	{
-		result = (result << 32) + (uint32_t)getInt(i);
+		throw "Negative bit address";
 	}
-	return result;
+	if (this->signum < 0)
+	{
+		return ~(~*this).flipBit(n);
+	}
+	std::vector<int32_t> result = widenToBit(this->mag, n);
+	result[result.size() - ((uint32_t)n >> 5) - 1] ^= 1 << (n & 31);
+	return BigInteger(1, stripLeadingZeroInts(result));
 }
 
-size_t BigInteger::bitLength() const
+int BigInteger::bitCount() const
 {
-	int n;
-	std::vector<int32_t> m = this->mag;
-	size_t len = m.size();
-	if (len == 0)
+	int bc = LimbKernels::popCount(this->mag.data(), this->mag.size());
+	if (this->signum < 0)
 	{
-		n = 0;
+		// the two's complement of a negative value differs from its sign bit
+		// in every bit of |x| - 1
+		bc += getLowestSetBit() - 1;
 	}
-	else
+	return bc;
+}
+
+BigInteger BigInteger::divide(const BigInteger & val, BigInteger & quotient) const
+{
+	BigInteger r = divideKnuth(val, quotient);
+	quotient = quotient.withSign(this->signum == val.signum ? 1 : -1);
+	return r.withSign(this->signum);
+}
+
+uint64_t BigInteger::divRemWord(uint64_t divisor, BigInteger & quotient) const
+{
+	if (divisor == 0)
 	{
-		int magBitLength = ((len - 1) << 5) + bitLengthForInt(m[0]);
-		if (this->signum < 0)
-		{
-			bool pow2 = bitCount(m[0]) == 1;
-			for (size_t i = 1; i < len && pow2; i++)
-			{
-				pow2 = m[i] == 0;
-			}
-			n = pow2 ? magBitLength - 1 : magBitLength;
-		}
-		else
-		{
-			n = magBitLength;
-		}
+		throw "BigInteger divide by zero";
 	}
-	return n;
+	if (this->signum == 0)
+	{
+		quotient = 0;
+		return 0;
+	}
+	COUNT_PATH(DIVIDE_ONE_WORD, this->mag.size());
+	// the quotient replaces a copy of the dividend word by word
+	std::vector<int32_t> q(this->mag.begin(), this->mag.end());
+	uint64_t r = divisor >> 32 == 0 ? divideByInt(q.data(), q.size(), (uint32_t)divisor, q.data()) : divideByLong(q.data(), q.size(), divisor, q.data());
+	trimLeadingZeroInts(q);
+	quotient = BigInteger(this->signum, std::move(q));
+	return r;
 }
 
-BigInteger::~BigInteger()
+uint64_t BigInteger::modWord(uint64_t divisor) const
 {
+	uint64_t r = remainderWord(divisor);
+	return this->signum < 0 && r != 0 ? divisor - r : r;
 }
 
-int BigInteger::compare(const BigInteger & rhs) const
+BigInteger BigInteger::divideExact(const BigInteger & val) const
 {
-	if (this->signum == rhs.signum)
+	if (val.signum == 0)
 	{
-		switch (this->signum)
+		throw "BigInteger divide by zero";
+	}
+	// the divisor's trailing zeros come off both sides, leaving it odd and
+	// so invertible modulo a word
+	int zeros = val.getLowestSetBit();
+	BigInteger a = this->abs() >> zeros;
+	BigInteger d = val.abs() >> zeros;
+	BigInteger quotient;
+	if (a.mag.size() >= d.mag.size())
+	{
+		uint32_t d0 = (uint32_t)d.mag.back();
+		uint32_t inverse = d0;
+		for (int k = 0; k < 4; k++)
 		{
-		case 1:
-			return compareMagnitude(rhs);
-		case -1:
-			return rhs.compareMagnitude(*this);
-		default:
-			return 0;
+			inverse *= 2 - d0 * inverse;
 		}
+		// the quotient has at most this many words, so it is exactly the
+		// quotient modulo their size
+		quotient = divideHensel(a, d, a.mag.size() - d.mag.size() + 1, inverse).withSign(this->signum * val.signum);
 	}
-	return this->signum > rhs.signum ? 1 : -1;
+#ifndef NDEBUG
+	if (quotient * val != *this)
+	{
+		throw "BigInteger division not exact";
+	}
+#endif
+	return quotient;
 }
 
-int BigInteger::compareMagnitude(const BigInteger & rhs) const
+BigInteger BigInteger::gcd(const BigInteger & val) const
 {
-	std::vector<int32_t> m1 = this->mag;
-	size_t len1 = m1.size();
-	std::vector<int32_t> m2 = rhs.mag;
-	size_t len2 = m2.size();
-	if (len1 < len2)
-	{
-		return -1;
-	}
-	if (len1 > len2)
+	BigInteger a = this->abs();
+	BigInteger b = val.abs();
+	while (b.signum != 0)
 	{
-		return 1;
+		BigInteger r = a % b;
+		a = b;
+		b = r;
 	}
-	for (size_t i = 0; i < len1; i++)
+	return a;
+}
+
+BigInteger BigInteger::mod(const BigInteger & m) const
+{
+	if (m.signum <= 0)
 	{
-		int32_t a = m1[i];
-		int32_t b = m2[i];
-		if (a != b)
-		{
-			return (uint32_t)a < (uint32_t)b ? -1 : 1;
-		}
+		throw "BigInteger: modulus not positive";
 	}
-	return 0;
+	BigInteger result = *this % m;
+	return result.signum >= 0 ? result : result + m;
 }
 
-BigInteger BigInteger::shiftRightImpl(int n) const
+BigInteger BigInteger::modInverse(const BigInteger & m) const
 {
-	size_t nInts = (uint32_t)n >> 5;
-	int nBits = n & 0x1F;
-	size_t magLen = mag.size();
+	if (m.signum <= 0)
+	{
+		throw "BigInteger: modulus not positive";
+	}
+	if (m == 1)
+	{
+		return 0;
+	}
+	BigInteger a = mod(m);
+	BigInteger b = m;
+	BigInteger x0 = 1;
+	BigInteger x1 = 0;
+	while (b.signum != 0)
+	{
+		BigInteger q;
+		BigInteger r = a.divide(b, q);
+		a = b;
+		b = r;
+		BigInteger x = x0 - q * x1;
+		x0 = x1;
+		x1 = x;
+	}
+	if (a != 1)
+	{
+		throw "BigInteger not invertible.";
+	}
+	return x0.mod(m);
+}
+
+BigInteger BigInteger::modPow(const BigInteger & exponent, const BigInteger & m) const
+{
+	if (m.signum <= 0)
+	{
+		throw "BigInteger: modulus not positive";
+	}
+	if (exponent.signum < 0)
+	{
+		return modInverse(m).modPow(-exponent, m);
+	}
+	if (m == 1)
+	{
+		return 0;
+	}
+	if (exponent.signum == 0)
+	{
+		return 1;
+	}
+	size_t bits = exponent.bitLength();
+	int wbits = 1;
+	while ((int)bits > EXP_MOD_THRESHOLDS[wbits - 1])
+	{
+		wbits++;
+	}
+	// odd powers base^1, base^3, ..., base^(2^wbits - 1)
+	std::vector<BigInteger> table(1 << (wbits - 1));
+	table[0] = mod(m);
+	BigInteger square = (table[0] * table[0]).mod(m);
+	for (size_t i = 1; i < table.size(); i++)
+	{
+		table[i] = (table[i - 1] * square).mod(m);
+	}
+	BigInteger result = 1;
+	for (size_t i = bits; i-- > 0; )
+	{
+		if (!exponent.testBit((int32_t)i))
+		{
+			result = (result * result).mod(m);
+			continue;
+		}
+		// sliding window: the longest run of at most wbits bits that starts
+		// at bit i and ends on a set bit
+		size_t low = i + 1 >= (size_t)wbits ? i + 1 - wbits : 0;
+		while (!exponent.testBit((int32_t)low))
+		{
+			low++;
+		}
+		int width = (int)(i - low + 1);
+		for (int k = 0; k < width; k++)
+		{
+			result = (result * result).mod(m);
+		}
+		result = (result * table[exponent.bitWindow(low, width) >> 1]).mod(m);
+		i = low;
+	}
+	return result;
+}
+
+std::string BigInteger::toString() const
+{
+	return toString(10);
+}
+
+std::string BigInteger::toString(int radix) const
+{
+	if (this->signum == 0)
+	{
+		return "0";
+	}
+	if (radix < MIN_RADIX || radix > MAX_RADIX)
+	{
+		radix = 10;
+	}
+	if (this->mag.size() < SCHOENHAGE_BASE_CONVERSION_THRESHOLD)
+	{
+		return smallToString(radix);
+	}
+	COUNT_PATH(SCHOENHAGE_TO_STRING, this->mag.size());
+	std::string sb;
+	sb.reserve((size_t)(bitLength() * LOG_TWO / std::log((double)radix)) + 2);
+	if (this->signum < 0)
+	{
+		toString(-*this, sb, radix, 0, SCHOENHAGE_BASE_CONVERSION_THRESHOLD);
+		sb.insert(0, "-");
+	}
+	else
+	{
+		toString(*this, sb, radix, 0, SCHOENHAGE_BASE_CONVERSION_THRESHOLD);
+	}
+	return sb;
+}
+
+int64_t BigInteger::longValue() const
+{
+	int64_t result = 0;
+	for (size_t i = 2; i-- > 0; )
+	{
+		result = (result << 32) + (uint32_t)getInt(i);
+	}
+	return result;
+}
+
+double BigInteger::toDouble() const
+{
+	size_t len = this->mag.size();
+	if (len <= 2)
+	{
+		// up to 64 bits the conversion itself rounds correctly
+		double magnitude = (double)wordMagnitude();
+		return this->signum < 0 ? -magnitude : magnitude;
+	}
+	int top = bitLengthForInt(this->mag[0]);
+	size_t bits = (len - 1) * 32 + top;
+	if (bits > 1024)
+	{
+		return this->signum * std::numeric_limits<double>::infinity();
+	}
+	// The leading 64 bits are converted with any bits below them folded
+	// into the lowest, which sits under the rounding bit of a double and so
+	// breaks ties the way the whole magnitude would
+	uint64_t high = (uint64_t)(uint32_t)this->mag[0] << 32 | (uint32_t)this->mag[1];
+	uint64_t next = (uint32_t)this->mag[2];
+	uint64_t leading = high << (32 - top) | next >> top;
+	bool sticky = next << (64 - top) != 0;
+	for (size_t i = 3; i < len && !sticky; i++)
+	{
+		sticky = this->mag[i] != 0;
+	}
+	double magnitude = std::ldexp((double)(leading | (sticky ? 1 : 0)), (int)bits - 64);
+	return this->signum < 0 ? -magnitude : magnitude;
+}
+
+BigInteger BigInteger::fromDouble(double value)
+{
+	if (!std::isfinite(value))
+	{
+		throw "Infinite or NaN";
+	}
+	int exponent;
+	double fraction = std::frexp(std::fabs(value), &exponent);
+	if (exponent <= 0)
+	{
+		return 0;
+	}
+	// the 53 significant bits as an integer, scaled back by a shift
+	uint64_t significand = (uint64_t)std::ldexp(fraction, 53);
+	int sign = value < 0 ? -1 : 1;
+	if (exponent <= 53)
+	{
+		return valueOf(sign, significand >> (53 - exponent));
+	}
+	return valueOf(sign, significand) << (exponent - 53);
+}
+
+size_t BigInteger::bitLength() const
+{
+	int n;
+	const std::vector<int32_t> & m = this->mag;
+	size_t len = m.size();
+	if (len == 0)
+	{
+		n = 0;
+	}
+	else
+	{
+		int magBitLength = ((len - 1) << 5) + bitLengthForInt(m[0]);
+		if (this->signum < 0)
+		{
+			bool pow2 = bitCount(m[0]) == 1;
+			for (size_t i = 1; i < len && pow2; i++)
+			{
+				pow2 = m[i] == 0;
+			}
+			n = pow2 ? magBitLength - 1 : magBitLength;
+		}
+		else
+		{
+			n = magBitLength;
+		}
+	}
+	return n;
+}
+
+size_t BigInteger::hashCode() const
+{
+	return (size_t)hashWords(this->signum, this->mag.data(), this->mag.size());
+}
+
+BigInteger BigInteger::factorial(int32_t n)
+{
+	if (n < 0)
+	{
+		throw "Negative factorial";
+	}
+	// n! = 2^(n - bitCount(n)) * product of oddProduct(n >> k) for all k,
+	// where oddProduct(m) is the product of the odd numbers up to m
+	BigInteger oddProduct = 1;
+	BigInteger oddPart = 1;
+	uint64_t processed = 1;
+	for (int k = bitLengthForInt(n); k-- > 0; )
+	{
+		uint64_t m = (uint32_t)n >> k;
+		uint64_t hi = (m - 1) | 1;
+		if (hi > processed)
+		{
+			oddProduct = oddProduct * multiplyRange(processed + 2, hi, 2);
+			processed = hi;
+		}
+		oddPart = oddPart * oddProduct;
+	}
+	return oddPart << (n - bitCount(n));
+}
+
+BigInteger BigInteger::binomial(int32_t n, int32_t k)
+{
+	if (n < 0)
+	{
+		throw "Negative binomial";
+	}
+	if (k < 0 || k > n)
+	{
+		return 0;
+	}
+	if (k > n - k)
+	{
+		k = n - k;
+	}
+	if (k == 0)
+	{
+		return 1;
+	}
+	// The k terms of the falling product hold about k log n bits, so while
+	// that is short of n they cost less than sieving to n does
+	if ((uint64_t)k * bitLengthForInt(n) < (uint64_t)n)
+	{
+		return productRange(n - k + 1, n).divideExact(factorial(k));
+	}
+	// Otherwise n is within a log of k and the sieve is no larger than the
+	// product. Collect the prime factorization of n! / (k! (n - k)!) and
+	// multiply the prime powers together, which keeps the operands balanced
+	std::vector<bool> composite(n + 1);
+	std::vector<uint64_t> factors;
+	for (uint64_t p = 2; p <= (uint64_t)n; p++)
+	{
+		if (composite[p])
+		{
+			continue;
+		}
+		for (uint64_t m = p * p; m <= (uint64_t)n; m += p)
+		{
+			composite[m] = true;
+		}
+		int e;
+		if (p > (uint64_t)(n - k))
+		{
+			e = 1;
+		}
+		else if (p > (uint64_t)n / 2)
+		{
+			e = 0;
+		}
+		else if (p * p > (uint64_t)n)
+		{
+			e = n % p < k % p ? 1 : 0;
+		}
+		else
+		{
+			e = 0;
+			for (uint64_t q = p; q <= (uint64_t)n; q *= p)
+			{
+				e += (int)(n / q - k / q - (n - k) / q);
+			}
+		}
+		while (e-- > 0)
+		{
+			factors.push_back(p);
+		}
+	}
+	return multiplyFactors(factors, 0, factors.size());
+}
+
+BigInteger BigInteger::productRange(int64_t a, int64_t b)
+{
+	if (a > b)
+	{
+		return 1;
+	}
+	if (a <= 0 && b >= 0)
+	{
+		return 0;
+	}
+	if (a > 0)
+	{
+		return multiplyRange(a, b, 1);
+	}
+	// -(x + 1) + 1 avoids overflowing on INT64_MIN
+	uint64_t lo = (uint64_t)-(b + 1) + 1;
+	uint64_t hi = (uint64_t)-(a + 1) + 1;
+	BigInteger result = multiplyRange(lo, hi, 1);
+	return ((hi - lo) & 1) == 0 ? -result : result;
+}
+
+std::vector<std::vector<BigInteger>> BigInteger::productTree(const std::vector<BigInteger> & values)
+{
+	std::vector<std::vector<BigInteger>> tree;
+	if (values.empty())
+	{
+		return tree;
+	}
+	tree.push_back(values);
+	while (tree.back().size() > 1)
+	{
+		const std::vector<BigInteger> & level = tree.back();
+		std::vector<BigInteger> next((level.size() + 1) / 2);
+		forEachNode(next.size(), levelLength(level), [&](size_t i)
+		{
+			next[i] = 2 * i + 1 < level.size() ? level[2 * i] * level[2 * i + 1] : level[2 * i];
+		});
+		tree.push_back(std::move(next));
+	}
+	return tree;
+}
+
+std::vector<BigInteger> BigInteger::remainders(const BigInteger & x, const std::vector<BigInteger> & moduli)
+{
+	return remainders(x, productTree(moduli));
+}
+
+std::vector<BigInteger> BigInteger::remainders(const BigInteger & x, const std::vector<std::vector<BigInteger>> & tree)
+{
+	if (tree.empty())
+	{
+		return std::vector<BigInteger>();
+	}
+	// x % node stays congruent to x modulo every leaf below node, so each
+	// level only has to reduce the smaller remainder of its parent
+	std::vector<BigInteger> rems{ x % tree.back()[0] };
+	for (size_t depth = tree.size() - 1; depth-- > 0; )
+	{
+		const std::vector<BigInteger> & level = tree[depth];
+		std::vector<BigInteger> next(level.size());
+		forEachNode(next.size(), levelLength(level), [&](size_t i)
+		{
+			next[i] = rems[i / 2] % level[i];
+		});
+		rems = std::move(next);
+	}
+	return rems;
+}
+
+std::vector<BigInteger> BigInteger::batchGcd(const std::vector<BigInteger> & values)
+{
+	std::vector<std::vector<BigInteger>> tree = productTree(values);
+	if (tree.empty())
+	{
+		return std::vector<BigInteger>();
+	}
+	// Bernstein: with P the product of all values, gcd(x, P / x) is
+	// gcd(x, (P % x^2) / x), and P % x^2 comes out of a remainder tree
+	// over the squared nodes
+	std::vector<BigInteger> rems{ tree.back()[0] };
+	for (size_t depth = tree.size() - 1; depth-- > 0; )
+	{
+		const std::vector<BigInteger> & level = tree[depth];
+		std::vector<BigInteger> next(level.size());
+		forEachNode(next.size(), 2 * levelLength(level), [&](size_t i)
+		{
+			next[i] = rems[i / 2] % (level[i] * level[i]);
+		});
+		rems = std::move(next);
+	}
+	std::vector<BigInteger> gcds(values.size());
+	forEachNode(gcds.size(), levelLength(values), [&](size_t i)
+	{
+		gcds[i] = (rems[i] / values[i]).gcd(values[i]);
+	});
+	return gcds;
+}
+
+BigInteger BigInteger::multiExp(const std::vector<BigInteger> & bases, const std::vector<BigInteger> & exponents, const BigInteger & m)
+{
+	if (bases.size() != exponents.size())
+	{
+		throw "Mismatched multiExp lengths";
+	}
+	if (m.signum <= 0)
+	{
+		throw "BigInteger: modulus not positive";
+	}
+	std::vector<BigInteger> b;
+	std::vector<BigInteger> e;
+	size_t bits = 0;
+	for (size_t i = 0; i < bases.size(); i++)
+	{
+		if (exponents[i].signum == 0)
+		{
+			continue;
+		}
+		b.push_back(exponents[i].signum < 0 ? bases[i].modInverse(m) : bases[i].mod(m));
+		e.push_back(exponents[i].abs());
+		bits = std::max(bits, e.back().bitLength());
+	}
+	if (m == 1)
+	{
+		return 0;
+	}
+	if (b.empty())
+	{
+		return 1;
+	}
+	if (b.size() < PIPPENGER_THRESHOLD)
+	{
+		return strausMultiExp(b, e, m, bits);
+	}
+	return pippengerMultiExp(b, e, m, bits);
+}
+
+BigInteger BigInteger::dot(const std::vector<BigInteger> & a, const std::vector<BigInteger> & b)
+{
+	if (a.size() != b.size())
+	{
+		throw "Mismatched dot lengths";
+	}
+	size_t words = 0;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		words += a[i].mag.size() + b[i].mag.size();
+	}
+	size_t runs = runCount(a.size());
+	std::vector<Columns> positive(runs), negative(runs);
+	forEachRun(runs, a.size(), words, [&](size_t run, size_t from, size_t to)
+	{
+		for (size_t i = from; i < to; i++)
+		{
+			int sign = a[i].signum * b[i].signum;
+			if (sign == 0)
+			{
+				continue;
+			}
+			Columns & columns = sign > 0 ? positive[run] : negative[run];
+			size_t xlen = a[i].mag.size(), ylen = b[i].mag.size();
+			if (xlen >= KARATSUBA_THRESHOLD && ylen >= KARATSUBA_THRESHOLD)
+			{
+				BigInteger z = multiplyKaratsuba(a[i], b[i]);
+				columns.add(z.mag.data(), z.mag.size());
+			}
+			else
+			{
+				// each product only lives long enough to be added
+				Scratch::Frame frame;
+				int32_t * z = frame.take(xlen + ylen);
+				LimbKernels::multiply(a[i].mag.data(), xlen, b[i].mag.data(), ylen, z);
+				columns.add(z, xlen + ylen);
+			}
+		}
+	});
+	return resolve(positive, negative);
+}
+
+BigInteger BigInteger::fma(const BigInteger & a, const BigInteger & b, const BigInteger & c)
+{
+	std::vector<int32_t> z = multiplyMagnitudes(a, b);
+	int sign = accumulate(z, a.signum * b.signum, c.mag.data(), c.mag.size(), c.signum);
+	trimLeadingZeroInts(z);
+	return BigInteger(sign, std::move(z));
+}
+
+BigInteger BigInteger::mulAdd(const BigInteger & a, const BigInteger & b, const BigInteger & c, const BigInteger & d)
+{
+	return multiplyAccumulate(a, b, c, d, 1);
+}
+
+BigInteger BigInteger::mulSub(const BigInteger & a, const BigInteger & b, const BigInteger & c, const BigInteger & d)
+{
+	return multiplyAccumulate(a, b, c, d, -1);
+}
+
+BigInteger BigInteger::addMod(const BigInteger & a, const BigInteger & b, const BigInteger & m)
+{
+	if (m.signum <= 0)
+	{
+		throw "BigInteger: modulus not positive";
+	}
+	std::vector<int32_t> z = a.mag;
+	int sign = accumulate(z, a.signum, b.mag.data(), b.mag.size(), b.signum);
+	if (sign > 0 && compareWords(z, m.mag) >= 0)
+	{
+		sign = accumulate(z, sign, m.mag.data(), m.mag.size(), -1);
+	}
+	trimLeadingZeroInts(z);
+	BigInteger sum(sign, std::move(z));
+	// only operands outside [0, m) can leave the sum outside it here
+	if (sum.signum < 0 || sum.compareMagnitude(m) >= 0)
+	{
+		return sum.mod(m);
+	}
+	return sum;
+}
+
+BigInteger::Stats BigInteger::stats(bool reset)
+{
+	Stats result = {};
+#if defined(BIGINTEGER_STATS)
+	StatsRegistry & registry = statsRegistry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+	uint64_t totals[STATS_COUNTERS];
+	for (size_t i = 0; i < STATS_COUNTERS; i++)
+	{
+		totals[i] = registry.retired[i];
+		for (auto block : registry.blocks)
+		{
+			totals[i] += block[i].load(std::memory_order_relaxed);
+		}
+	}
+	for (size_t p = 0; p < Stats::PATH_COUNT; p++)
+	{
+		result.calls[p] = totals[p] - registry.baseline[p];
+		result.words[p] = totals[Stats::PATH_COUNT + p] - registry.baseline[Stats::PATH_COUNT + p];
+	}
+	result.allocations = totals[2 * Stats::PATH_COUNT] - registry.baseline[2 * Stats::PATH_COUNT];
+	result.allocatedBytes = totals[2 * Stats::PATH_COUNT + 1] - registry.baseline[2 * Stats::PATH_COUNT + 1];
+	if (reset)
+	{
+		std::copy(totals, totals + STATS_COUNTERS, registry.baseline);
+	}
+#else
+	(void)reset;
+#endif
+	return result;
+}
+
+const char * BigInteger::Stats::pathName(Path path)
+{
+	static const char * const NAMES[] =
+	{
+		"multiplyByInt", "multiplyToLen", "multiplyKaratsuba", "divideOneWord", "divideMagnitude", "divideBurnikelZiegler",
+		"smallToString", "schoenhageToString"
+	};
+	return path < PATH_COUNT ? NAMES[path] : "unknown";
+}
+
+void BigInteger::setThreadPool(std::shared_ptr<ThreadPool> pool)
+{
+	std::atomic_store(&poolSlot(), pool);
+}
+
+std::shared_ptr<ThreadPool> BigInteger::threadPool()
+{
+	return std::atomic_load(&poolSlot());
+}
+
+std::shared_ptr<ThreadPool> & BigInteger::poolSlot()
+{
+	static std::shared_ptr<ThreadPool> pool;
+	return pool;
+}
+
+BigInteger::~BigInteger()
+{
+}
+
+int BigInteger::compare(const BigInteger & rhs) const
+{
+	if (this->signum == rhs.signum)
+	{
+		switch (this->signum)
+		{
+		case 1:
+			return compareMagnitude(rhs);
+		case -1:
+			return rhs.compareMagnitude(*this);
+		default:
+			return 0;
+		}
+	}
+	return this->signum > rhs.signum ? 1 : -1;
+}
+
+int BigInteger::compareMagnitude(const BigInteger & rhs) const
+{
+	const std::vector<int32_t> & m1 = this->mag;
+	size_t len1 = m1.size();
+	const std::vector<int32_t> & m2 = rhs.mag;
+	size_t len2 = m2.size();
+	if (len1 < len2)
+	{
+		return -1;
+	}
+	if (len1 > len2)
+	{
+		return 1;
+	}
+	for (size_t i = 0; i < len1; i++)
+	{
+		int32_t a = m1[i];
+		int32_t b = m2[i];
+		if (a != b)
+		{
+			return (uint32_t)a < (uint32_t)b ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+int BigInteger::compareWord(int sign, uint64_t magnitude) const
+{
+	if (this->signum != sign)
+	{
+		return this->signum > sign ? 1 : -1;
+	}
+	if (this->mag.size() > 2)
+	{
+		return this->signum;
+	}
+	uint64_t value = wordMagnitude();
+	if (value == magnitude)
+	{
+		return 0;
+	}
+	return (value > magnitude) == (sign > 0) ? 1 : -1;
+}
+
+BigInteger BigInteger::shiftRightImpl(int n) const
+{
+	size_t nInts = (uint32_t)n >> 5;
+	int nBits = n & 0x1F;
+	size_t magLen = mag.size();
 	std::vector<int32_t> newMag;
 	if (nInts >= magLen)
 	{
@@ -566,501 +1479,1092 @@ BigInteger BigInteger::shiftRightImpl(int n) const
 	}
 	if (nBits == 0)
 	{
-		newMag.insert(newMag.begin(), mag.begin(), mag.begin() + (magLen - nInts) + 1);
+		newMag.insert(newMag.begin(), mag.begin(), mag.begin() + (magLen - nInts));
 	}
 	else
 	{
-		int i = 0;
-		int32_t highBits = (uint32_t)mag[0] >> nBits;
-		if (highBits != 0)
+		int i = 0;
+		int32_t highBits = (uint32_t)mag[0] >> nBits;
+		if (highBits != 0)
+		{
+			newMag.assign(magLen - nInts, 0);
+			newMag[i++] = highBits;
+		}
+		else
+		{
+			newMag.assign(magLen - nInts - 1, 0);
+		}
+		LimbKernels::shiftLeft(newMag.data() + i, mag.data(), magLen - nInts - 1, 32 - nBits);
+	}
+	if (this->signum < 0)
+	{
+		bool onesLost = false;
+		for (size_t i = magLen, j = magLen - nInts; i-- > j && !onesLost; )
+		{
+			onesLost = this->mag[i] != 0;
+		}
+		if (!onesLost && nBits != 0)
+		{
+			onesLost = (this->mag[magLen - nInts - 1] << (32 - nBits)) != 0;
+		}
+		if (onesLost)
+		{
+			int32_t lastSum = 0;
+			for (size_t i = newMag.size(); i-- > 0 && lastSum == 0; )
+			{
+				lastSum = (newMag[i] += 1);
+			}
+			if (lastSum == 0)
+			{
+				newMag = std::vector<int32_t>(newMag.size() + 1);
+				newMag[0] = 1;
+			}
+		}
+	}
+	return BigInteger(this->signum, newMag);
+}
+
+std::string BigInteger::smallToString(int radix) const
+{
+	std::string buf;
+	smallToString(radix, buf, 0);
+	return buf;
+}
+
+void BigInteger::smallToString(int radix, std::string & buf, size_t digits) const
+{
+	Scratch::Frame frame;
+	int32_t * tmp = frame.take(this->mag.size());
+	std::copy(this->mag.begin(), this->mag.end(), tmp);
+	smallToString(this->signum, tmp, this->mag.size(), radix, buf, digits);
+}
+
+void BigInteger::smallToString(int signum, int32_t * tmp, size_t len, int radix, std::string & buf, size_t digits)
+{
+	static const char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+	if (signum == 0)
+	{
+		buf.append(std::max<size_t>(digits, 1), '0');
+		return;
+	}
+	COUNT_PATH(SMALL_TO_STRING, len);
+	// each group divides the words left in place, stepping over the
+	// quotient's leading zeros, and its digits are written into buf from
+	// the least significant end
+	uint64_t d = LONG_RADIX[radix];
+	size_t groupDigits = DIGITS_PER_LONG[radix];
+	size_t maxNumDigitGroups = (4 * len + 6) / 7;
+	size_t start = buf.size();
+	size_t end = start + std::max(maxNumDigitGroups * groupDigits, digits) + 1;
+	buf.resize(end);
+	size_t cursor = end;
+	size_t top = 0;
+	while (top < len)
+	{
+		uint64_t r = divideByLong(tmp + top, len - top, d, tmp + top);
+		while (top < len && tmp[top] == 0)
+		{
+			top++;
+		}
+		// every group but the most significant fills its width
+		size_t groupEnd = top < len ? cursor - groupDigits : cursor;
+		do
+		{
+			buf[--cursor] = DIGITS[r % radix];
+			r /= radix;
+		}
+		while (r != 0 || cursor > groupEnd);
+	}
+	while (end - cursor < digits)
+	{
+		buf[--cursor] = '0';
+	}
+	if (signum < 0)
+	{
+		buf[--cursor] = '-';
+	}
+	buf.erase(start, cursor - start);
+}
+
+BigInteger BigInteger::divideKnuth(const BigInteger & b, BigInteger & quotient) const
+{
+	if (b.mag.size() == 0)
+	{
+		throw "BigInteger divide by zero";
+	}
+	if (this->mag.size() == 0)
+	{
+		quotient = 0;
+		return 0;
+	}
+	int cmp = compareMagnitude(b);
+	if (cmp < 0)
+	{
+		quotient = 0;
+		return *this;
+	}
+	if (cmp == 0)
+	{
+		quotient = 1;
+		return 0;
+	}
+	if (b.mag.size() <= 2)
+	{
+		return valueOf(1, divRemWord(b.wordMagnitude(), quotient));
+	}
+	if (b.mag.size() >= BURNIKEL_ZIEGLER_THRESHOLD && this->mag.size() - b.mag.size() >= BURNIKEL_ZIEGLER_OFFSET)
+	{
+		return divideBurnikelZiegler(b, quotient);
+	}
+	if (this->mag.size() >= KNUTH_POW2_THRESH_LEN)
+	{
+		int lb1 = getLowestSetBit(), lb2 = b.getLowestSetBit();
+		int trailingZeroBits = lb1 < lb2 ? lb1 : lb2;
+		if (trailingZeroBits >= KNUTH_POW2_THRESH_ZEROS * 32)
+		{
+			return divideShifted(b, quotient, trailingZeroBits);
+		}
+	}
+	return divideMagnitude(b, quotient);
+}
+
+BigInteger BigInteger::divideShifted(const BigInteger & b, BigInteger & quotient, int trailingZeroBits) const
+{
+	// common trailing zeros leave the quotient unchanged and only scale
+	// the remainder, so dividing without them saves their share of every row
+	BigInteger r = (*this >> trailingZeroBits).divide(b >> trailingZeroBits, quotient);
+	return r << trailingZeroBits;
+}
+
+BigInteger BigInteger::divideSchoolbook(const BigInteger & b, BigInteger & quotient) const
+{
+	if (compareMagnitude(b) < 0)
+	{
+		quotient = 0;
+		return *this;
+	}
+	if (b.mag.size() <= 2)
+	{
+		return valueOf(1, divRemWord(b.wordMagnitude(), quotient));
+	}
+	return divideMagnitude(b, quotient);
+}
+
+BigInteger BigInteger::divideBurnikelZiegler(const BigInteger & b, BigInteger & quotient) const
+{
+	COUNT_PATH(DIVIDE_BURNIKEL_ZIEGLER, this->mag.size());
+	// with the divisor normalized to whole words the dividend splits into
+	// word aligned digits, each of which is one 2n by n division
+	int shift = (32 - (int)(b.bitLength() % 32)) % 32;
+	BigInteger a = this->abs() << shift;
+	BigInteger d = b.abs() << shift;
+	size_t length = d.mag.size();
+	size_t digits = (a.mag.size() + length - 1) / length;
+	std::vector<int32_t> q(digits * length);
+	BigInteger r;
+	for (size_t i = digits; i-- > 0; )
+	{
+		BigInteger digit;
+		divide2n1n((r << (int32_t)(32 * length)) + a.getBlock(i, length), d, length, digit, r);
+		std::copy(digit.mag.begin(), digit.mag.end(), q.end() - i * length - digit.mag.size());
+	}
+	quotient = BigInteger(1, stripLeadingZeroInts(q));
+	return r >> shift;
+}
+
+void BigInteger::divide2n1n(const BigInteger & a, const BigInteger & b, size_t n, BigInteger & quotient, BigInteger & remainder)
+{
+	if (n < BURNIKEL_ZIEGLER_THRESHOLD)
+	{
+		remainder = a.divideSchoolbook(b, quotient);
+		return;
+	}
+	// an odd length is padded by a word so the halves split evenly, which
+	// keeps the divisor normalized
+	size_t pad = n & 1;
+	BigInteger x = a << (int32_t)(32 * pad);
+	BigInteger y = b << (int32_t)(32 * pad);
+	n += pad;
+	size_t half = n / 2;
+	BigInteger y1 = y.getUpper(half);
+	BigInteger y2 = y.getLower(half);
+	BigInteger q1, q2, r;
+	divide3n2n(x.getUpper(n), x.getBlock(1, half), y, y1, y2, half, q1, r);
+	divide3n2n(r, x.getLower(half), y, y1, y2, half, q2, r);
+	quotient = (q1 << (int32_t)(32 * half)) + q2;
+	remainder = r >> (int32_t)(32 * pad);
+}
+
+void BigInteger::divide3n2n(const BigInteger & a12, const BigInteger & a3, const BigInteger & b, const BigInteger & b1, const BigInteger & b2, size_t n, BigInteger & quotient, BigInteger & remainder)
+{
+	BigInteger r;
+	if (a12.getUpper(n) == b1)
+	{
+		// the estimate would overflow n words, and the largest digit is at
+		// most two too big
+		quotient = (BigInteger(1) << (int32_t)(32 * n)) - 1;
+		r = a12 - (b1 << (int32_t)(32 * n)) + b1;
+	}
+	else
+	{
+		divide2n1n(a12, b1, n, quotient, r);
+	}
+	r = (r << (int32_t)(32 * n)) + a3 - quotient * b2;
+	while (r.signum < 0)
+	{
+		quotient = quotient - 1;
+		r = r + b;
+	}
+	remainder = r;
+}
+
+BigInteger BigInteger::divideHensel(const BigInteger & a, const BigInteger & d, size_t n, uint32_t inverse)
+{
+	if (n >= KARATSUBA_THRESHOLD)
+	{
+		// the low half of the quotient only depends on the low half of
+		// the operands, and what it leaves of a divides for the high half
+		size_t half = n / 2;
+		BigInteger q0 = divideHensel(a.getLower(half), d.getLower(half), half, inverse);
+		BigInteger rest = a.getLower(n) - (q0 * d.getLower(n)).getLower(n);
+		if (rest.signum < 0)
+		{
+			rest = rest + (BigInteger(1) << (int32_t)(32 * n));
+		}
+		BigInteger q1 = divideHensel(rest >> (int32_t)(32 * half), d, n - half, inverse);
+		return (q1 << (int32_t)(32 * half)) + q0;
+	}
+	// Hensel division: each quotient word is whatever clears the lowest
+	// word left of a, and only the words below n are ever updated
+	std::vector<uint32_t> w(n), y(std::min(n, d.mag.size())), q(n);
+	for (size_t k = 0; k < n && k < a.mag.size(); k++)
+	{
+		w[k] = (uint32_t)a.mag[a.mag.size() - 1 - k];
+	}
+	for (size_t k = 0; k < y.size(); k++)
+	{
+		y[k] = (uint32_t)d.mag[d.mag.size() - 1 - k];
+	}
+	for (size_t i = 0; i < n; i++)
+	{
+		uint32_t digit = w[i] * inverse;
+		q[i] = digit;
+		uint64_t carry = 0;
+		size_t j = 0;
+		for (; j < y.size() && i + j < n; j++)
+		{
+			uint64_t product = (uint64_t)digit * y[j] + carry;
+			uint32_t before = w[i + j];
+			w[i + j] = before - (uint32_t)product;
+			carry = (product >> 32) + (before < (uint32_t)product ? 1 : 0);
+		}
+		for (size_t k = i + j; carry != 0 && k < n; k++)
+		{
+			uint32_t before = w[k];
+			w[k] = before - (uint32_t)carry;
+			carry = before < (uint32_t)carry ? 1 : 0;
+		}
+	}
+	std::vector<int32_t> magnitude(q.rbegin(), q.rend());
+	trimLeadingZeroInts(magnitude);
+	return BigInteger(1, std::move(magnitude));
+}
+
+BigInteger BigInteger::divideMagnitude(const BigInteger & div, BigInteger & quotient) const
+{
+	if (div.mag.size() <= 1)
+	{
+		throw "Illegal divisor";
+	}
+	COUNT_PATH(DIVIDE_MAGNITUDE, this->mag.size());
+	// the normalized divisor, the running remainder and the quotient are
+	// scratch words, so only the two results are allocated
+	Scratch::Frame frame;
+	int shift = numberOfLeadingZeroes(div.mag[0]);
+	size_t dlen = div.mag.size();
+	size_t mlen = this->mag.size();
+	int32_t * divisor = frame.take(dlen);
+	// the remainder starts as the shifted dividend below one zero word
+	int32_t * rem = frame.take(mlen + 2);
+	size_t nlen;
+	if (shift > 0)
+	{
+		copyAndShift(div.mag.data(), dlen, divisor, shift);
+		if (numberOfLeadingZeroes(this->mag[0]) >= shift)
 		{
-			newMag.assign(magLen - nInts, 0);
-			newMag[i++] = highBits;
+			nlen = mlen;
+			copyAndShift(this->mag.data(), mlen, rem + 1, shift);
 		}
 		else
 		{
-			newMag.assign(magLen - nInts - 1, 0);
-		}
-		int nBits2 = 32 - nBits;
-		size_t j = 0;
-		while (j < magLen - nInts - 1)
-		{
-			newMag[i++] = mag[j++] << nBits2 | (uint32_t)mag[j] >> nBits;
+			nlen = mlen + 1;
+			rem[1] = (int32_t)((uint32_t)this->mag[0] >> (32 - shift));
+			copyAndShift(this->mag.data(), mlen, rem + 2, shift);
 		}
 	}
-	if (this->signum < 0)
+	else
 	{
-		bool onesLost = false;
-		for (size_t i = magLen, j = magLen - nInts; i-- > j && !onesLost; )
+		nlen = mlen;
+		std::copy(div.mag.begin(), div.mag.end(), divisor);
+		std::copy(this->mag.begin(), this->mag.end(), rem + 1);
+	}
+	size_t limit = nlen - dlen + 1;
+	int32_t * q = frame.take(limit);
+	const uint32_t dh = (uint32_t)divisor[0];
+	const uint32_t dl = (uint32_t)divisor[1];
+	for (size_t j = 0; j < limit; j++)
+	{
+		uint32_t qhat = 0;
+		uint32_t qrem = 0;
+		bool skipCorrection = false;
+		uint32_t nh = (uint32_t)rem[j];
+		uint32_t nm = (uint32_t)rem[j + 1];
+		if (nh == dh)
 		{
-			onesLost = this->mag[i] != 0;
+			qhat = ~(uint32_t)0;
+			qrem = nh + nm;
+			skipCorrection = qrem < nh;
 		}
-		if (!onesLost && nBits != 0)
+		else
 		{
-			onesLost = (this->mag[magLen - nInts - 1] << (32 - nBits)) != 0;
+			uint64_t tmp = divWord(((uint64_t)nh << 32) | nm, dh);
+			qhat = (uint32_t)tmp;
+			qrem = (uint32_t)(tmp >> 32);
 		}
-		if (onesLost)
+		if (qhat == 0)
 		{
-			int32_t lastSum = 0;
-			for (size_t i = newMag.size(); i-- > 0 && lastSum == 0; )
-			{
-				lastSum = (newMag[i] += 1);
-			}
-			if (lastSum == 0)
+			continue;
+		}
+		if (!skipCorrection)
+		{
+			uint32_t nl = (uint32_t)rem[j + 2];
+			uint64_t rs = ((uint64_t)qrem << 32) | nl;
+			uint64_t estProduct = (uint64_t)dl * qhat;
+			if (estProduct > rs)
 			{
-				newMag = std::vector<int32_t>(newMag.size() + 1);
-				newMag[0] = 1;
+				qhat--;
+				qrem += dh;
+				if (qrem >= dh)
+				{
+					estProduct -= dl;
+					rs = ((uint64_t)qrem << 32) | nl;
+					if (estProduct > rs)
+					{
+						qhat--;
+					}
+				}
 			}
 		}
+		rem[j] = 0;
+		uint32_t borrow = (uint32_t)mulsub(rem, divisor, (int32_t)qhat, dlen, j);
+		if (borrow > nh)
+		{
+			divadd(divisor, dlen, rem, j + 1);
+			qhat--;
+		}
+		q[j] = (int32_t)qhat;
 	}
-	return BigInteger(this->signum, newMag);
+	std::vector<int32_t> qmag(q, q + limit);
+	trimLeadingZeroInts(qmag);
+	quotient = BigInteger(1, std::move(qmag));
+	// what is left is the last dlen words, shifted back down
+	const int32_t * r = rem + limit;
+	std::vector<int32_t> rmag(dlen);
+	for (size_t i = 0; i < dlen; i++)
+	{
+		uint64_t pair = ((uint64_t)(i == 0 ? 0 : (uint32_t)r[i - 1]) << 32) | (uint32_t)r[i];
+		rmag[i] = (int32_t)(pair >> shift);
+	}
+	trimLeadingZeroInts(rmag);
+	return BigInteger(1, std::move(rmag));
 }
 
-std::string BigInteger::smallToString(int radix) const
+BigInteger BigInteger::multiplyByInt(const std::vector<int32_t> & x, int32_t y, int sign)
 {
-	if (this->signum == 0)
+	COUNT_PATH(MULTIPLY_BY_INT, x.size());
+	if (bitCount(y) == 1)
 	{
-		return "0";
+		return BigInteger(sign, shiftLeft(x, numberOfTrailingZeroes(y)));
 	}
-	int maxNumDigitGroups = (4 * this->mag.size() + 6) / 7;
-	std::vector<std::string> digitGroup(maxNumDigitGroups);
-	BigInteger tmp = this->abs();
-	int numGroups = 0;
-	while (tmp.signum != 0)
+	size_t xlen = x.size();
+	std::vector<int32_t> rmag(xlen + 1, 0);
+	uint64_t carry = 0;
+	uint32_t y1 = (uint32_t)y;
+	size_t rstart = rmag.size() - 1;
+	for (size_t i = xlen; i-- > 0; )
 	{
-		BigInteger d = LONG_RADIX[radix];
-		BigInteger q;
-		BigInteger r = tmp.divide(d, q);
-		digitGroup[numGroups++] = longToString(r.longValue(), radix);
-		tmp = q;
+		uint64_t product = (uint64_t)(uint32_t)x[i] * y1 + carry;
+		rmag[rstart--] = (int32_t)product;
+		carry = product >> 32;
 	}
-	std::string buf;
-	buf.reserve(numGroups * DIGITS_PER_LONG[radix] + 1);
-	if (this->signum < 0)
+	if (carry == 0)
 	{
-		buf.append("-");
+		rmag.erase(rmag.begin());
 	}
-	buf.append(digitGroup[numGroups - 1]);
-	for (int i = numGroups - 2; i >= 0; i--)
+	else
 	{
-		int numLeadingZeroes = DIGITS_PER_LONG[radix] - digitGroup[i].size();
-		if (numLeadingZeroes != 0)
-		{
-			buf.append(ZEROES[numLeadingZeroes]);
-		}
-		buf.append(digitGroup[i]);
+		rmag[rstart] = (int32_t)carry;
 	}
-	return buf;
+	return BigInteger(sign, rmag);
 }
 
-BigInteger BigInteger::divideKnuth(const BigInteger & b, BigInteger & quotient) const
+BigInteger BigInteger::multiplyByLong(const std::vector<int32_t> & x, uint64_t y, int sign)
 {
-	if (b.mag.size() == 0)
+	COUNT_PATH(MULTIPLY_BY_INT, x.size());
+	uint32_t yh = (uint32_t)(y >> 32);
+	uint32_t yl = (uint32_t)y;
+	size_t xlen = x.size();
+	std::vector<int32_t> rmag(xlen + 2, 0);
+	uint64_t carry = 0;
+	size_t rstart = rmag.size() - 1;
+	for (size_t i = xlen; i-- > 0; )
 	{
-		throw "BigInteger divide by zero";
+		uint64_t product = (uint64_t)(uint32_t)x[i] * yl + carry;
+		rmag[rstart--] = (int32_t)product;
+		carry = product >> 32;
 	}
-	if (this->mag.size() == 0)
+	rmag[rstart] = (int32_t)carry;
+	carry = 0;
+	rstart = rmag.size() - 2;
+	for (size_t i = xlen; i-- > 0; )
 	{
-		quotient = 0;
-		return 0;
+		uint64_t product = (uint64_t)(uint32_t)x[i] * yh + (uint32_t)rmag[rstart] + carry;
+		rmag[rstart--] = (int32_t)product;
+		carry = product >> 32;
 	}
-	int cmp = compareMagnitude(b);
-	if (cmp < 0)
+	rmag[0] = (int32_t)carry;
+	if (carry == 0)
+	{
+		rmag.erase(rmag.begin());
+	}
+	return BigInteger(sign, rmag);
+}
+
+BigInteger & BigInteger::addWord(int sign, uint64_t magnitude)
+{
+	if (sign == 0)
 	{
-		quotient = 0;
 		return *this;
 	}
-	if (cmp == 0)
+	if (this->signum == 0)
 	{
-		quotient = 1;
-		return 0;
+		return *this = valueOf(sign, magnitude);
 	}
-	if (b.mag.size() == 1)
+	std::vector<int32_t> & m = this->mag.edit();
+	if (this->signum == sign)
 	{
-		return divideOneWord(b.mag[0], quotient);
+		// the words are added in place, and only a carry out of the top
+		// word grows the magnitude
+		uint64_t carry = 0;
+		for (size_t i = m.size(); i-- > 0 && (magnitude != 0 || carry != 0); magnitude >>= 32)
+		{
+			uint64_t sum = (uint64_t)(uint32_t)m[i] + (uint32_t)magnitude + carry;
+			m[i] = (int32_t)sum;
+			carry = sum >> 32;
+		}
+		for (; magnitude != 0 || carry != 0; magnitude >>= 32)
+		{
+			uint64_t sum = (uint64_t)(uint32_t)magnitude + carry;
+			m.insert(m.begin(), (int32_t)sum);
+			carry = sum >> 32;
+		}
+		return *this;
 	}
-	if (false && this->mag.size() >= KNUTH_POW2_THRESH_LEN)
+	int cmp = compareWord(this->signum, magnitude) * this->signum;
+	if (cmp == 0)
 	{
-		int lb1 = getLowestSetBit(), lb2 = b.getLowestSetBit();
-		int trailingZeroBits = lb1 < lb2 ? lb1 : lb2;
-		if (trailingZeroBits >= KNUTH_POW2_THRESH_ZEROS * 32)
+		this->signum = 0;
+		m.clear();
+	}
+	else if (cmp > 0)
+	{
+		int64_t borrow = 0;
+		for (size_t i = m.size(); i-- > 0 && (magnitude != 0 || borrow != 0); magnitude >>= 32)
+		{
+			int64_t difference = (int64_t)(uint32_t)m[i] - (uint32_t)magnitude + borrow;
+			m[i] = (int32_t)difference;
+			borrow = difference >> 32;
+		}
+		size_t keep = 0;
+		while (m[keep] == 0)
 		{
-			BigInteger r = (*this >> trailingZeroBits).divide(b >> trailingZeroBits, quotient);
-			r = r << trailingZeroBits;
-			return r;
+			keep++;
 		}
+		m.erase(m.begin(), m.begin() + keep);
 	}
-	return divideMagnitude(b, quotient);
+	else
+	{
+		*this = valueOf(sign, magnitude - wordMagnitude());
+	}
+	return *this;
 }
 
-int32_t BigInteger::divideOneWord(int32_t divisor, BigInteger & quotient) const
+BigInteger BigInteger::multiplyWord(int sign, uint64_t magnitude) const
 {
-	uint32_t divisorLong = (uint32_t)divisor;
-	if (this->mag.size() == 1)
+	if (sign == 0 || this->signum == 0)
 	{
-		uint32_t dividendValue = (uint32_t)this->mag[0];
-		int32_t q = (int32_t)(dividendValue / divisorLong);
-		int32_t r = (int32_t)(dividendValue - q * divisorLong);
-		quotient = q;
-		return r;
+		return 0;
 	}
-	MutableBigInteger q;
-	q.value.assign(this->mag.size(), 0);
-	q.offset = 0;
-	q.intLen = this->mag.size();
-	int shift = numberOfLeadingZeroes(divisor);
-	int32_t rem = this->mag[0];
-	uint32_t remLong = (uint32_t)rem;
-	if (remLong < divisorLong)
+	if (magnitude >> 32 == 0)
 	{
-		q.value[0] = 0;
+		return multiplyByInt(this->mag, (int32_t)magnitude, this->signum * sign);
 	}
-	else
+	return multiplyByLong(this->mag, magnitude, this->signum * sign);
+}
+
+uint64_t BigInteger::divideWord(int sign, uint64_t magnitude, BigInteger & quotient) const
+{
+	if (sign == 0)
 	{
-		q.value[0] = (int32_t)(remLong / divisorLong);
-		rem = (int32_t)(remLong - q.value[0] * divisorLong);
-		remLong = (uint32_t)rem;
+		throw "BigInteger divide by zero";
 	}
-	size_t xlen = this->mag.size();
-	while (--xlen > 0)
+	uint64_t r = divRemWord(magnitude, quotient);
+	quotient.signum *= sign;
+	return r;
+}
+
+uint64_t BigInteger::remainderWord(uint64_t divisor) const
+{
+	if (divisor == 0)
+	{
+		throw "BigInteger divide by zero";
+	}
+	if (this->signum == 0)
+	{
+		return 0;
+	}
+	COUNT_PATH(DIVIDE_ONE_WORD, this->mag.size());
+	const int32_t * x = this->mag.data();
+	return divisor >> 32 == 0 ? divideByInt(x, this->mag.size(), (uint32_t)divisor, nullptr) : divideByLong(x, this->mag.size(), divisor, nullptr);
+}
+
+uint64_t BigInteger::wordMagnitude() const
+{
+	uint64_t value = 0;
+	for (int32_t word : this->mag)
+	{
+		value = value << 32 | (uint32_t)word;
+	}
+	return value;
+}
+
+BigInteger BigInteger::valueOf(int sign, uint64_t magnitude)
+{
+	std::vector<int32_t> words;
+	if (magnitude >> 32 != 0)
+	{
+		words.push_back((int32_t)(magnitude >> 32));
+	}
+	if (magnitude != 0)
 	{
-		int64_t dividendEstimate = ((uint64_t)remLong << 32) | (uint32_t)this->mag[this->mag.size() - xlen];
-		int32_t qhat;
-		if (dividendEstimate >= 0)
+		words.push_back((int32_t)magnitude);
+	}
+	return BigInteger(sign, words);
+}
+
+BigInteger BigInteger::multiplyKaratsuba(const BigInteger & x, const BigInteger & y)
+{
+	COUNT_PATH(MULTIPLY_KARATSUBA, x.mag.size() + y.mag.size());
+	const BigInteger & longer = x.mag.size() >= y.mag.size() ? x : y;
+	const BigInteger & shorter = x.mag.size() >= y.mag.size() ? y : x;
+	size_t half = (longer.mag.size() + 1) / 2;
+	if (shorter.mag.size() <= half)
+	{
+		// splitting in half would leave one operand without an upper part, so
+		// the longer is cut into blocks the length of the shorter instead
+		size_t length = shorter.mag.size();
+		size_t blocks = (longer.mag.size() + length - 1) / length;
+		std::vector<BigInteger> products(blocks);
+		std::vector<std::function<void()>> tasks;
+		for (size_t i = 0; i < blocks; i++)
 		{
-			qhat = (int32_t)(dividendEstimate / divisorLong);
-			rem = (int32_t)(dividendEstimate - qhat * divisorLong);
+			tasks.push_back([&, i] { products[i] = longer.getBlock(i, length) * shorter; });
 		}
-		else
+		forkJoin(longer.mag.size() + length, tasks);
+		// products of alternate blocks never overlap, so each half of the
+		// sum is laid out directly
+		std::vector<int32_t> sums[2];
+		for (size_t i = 0; i < blocks; i++)
+		{
+			std::vector<int32_t> & sum = sums[i & 1];
+			sum.resize(longer.mag.size() + length);
+			const std::vector<int32_t> & product = products[i].mag;
+			std::copy(product.begin(), product.end(), sum.end() - i * length - product.size());
+		}
+		return BigInteger(1, stripLeadingZeroInts(sums[0])) + BigInteger(1, stripLeadingZeroInts(sums[1]));
+	}
+	BigInteger xl = x.getLower(half), xh = x.getUpper(half);
+	BigInteger yl = y.getLower(half), yh = y.getUpper(half);
+	BigInteger p1, p2, p3;
+	forkJoin(x.mag.size() + y.mag.size(),
+	{
+		[&] { p1 = xh * yh; },
+		[&] { p2 = xl * yl; },
+		[&] { p3 = (xh + xl) * (yh + yl); }
+	});
+	// p3 - p1 - p2 is the cross term xh * yl + xl * yh
+	return (((p1 << (int32_t)(32 * half)) + (p3 - p1 - p2)) << (int32_t)(32 * half)) + p2;
+}
+
+BigInteger BigInteger::multiplyRange(uint64_t lo, uint64_t hi, uint64_t step)
+{
+	uint64_t count = (hi - lo) / step + 1;
+	if (count <= PRODUCT_LEAF_LENGTH)
+	{
+		std::vector<uint64_t> factors;
+		for (uint64_t i = 0; i < count; i++)
 		{
-			int64_t tmp = divWord(dividendEstimate, divisor);
-			qhat = (int32_t)tmp;
-			rem = (int32_t)((uint64_t)tmp >> 32);
+			factors.push_back(lo + i * step);
 		}
-		q.value[this->mag.size() - xlen] = qhat;
-		remLong = (int32_t)rem;
+		return multiplyFactors(factors, 0, count);
 	}
-	quotient = q.toBigInteger();
-	if (shift > 0)
+	uint64_t mid = lo + count / 2 * step;
+	return multiplyRange(lo, mid - step, step) * multiplyRange(mid, hi, step);
+}
+
+BigInteger BigInteger::multiplyFactors(const std::vector<uint64_t> & factors, size_t from, size_t to)
+{
+	if (to - from > PRODUCT_LEAF_LENGTH)
+	{
+		size_t mid = from + (to - from) / 2;
+		return multiplyFactors(factors, from, mid) * multiplyFactors(factors, mid, to);
+	}
+	BigInteger result = 1;
+	uint64_t word = 1;
+	for (size_t i = from; i < to; i++)
 	{
-		return rem % divisor;
+		if (word > UINT64_MAX / factors[i])
+		{
+			result = result * valueOfWord(word);
+			word = 1;
+		}
+		word *= factors[i];
 	}
-	return rem;
+	return result * valueOfWord(word);
 }
 
-BigInteger BigInteger::divideMagnitude(const BigInteger & div, BigInteger & quotient) const
+BigInteger BigInteger::valueOfWord(uint64_t val)
 {
-	if (div.mag.size() <= 1)
+	std::vector<int32_t> magnitude;
+	if ((val >> 32) != 0)
 	{
-		throw "Illegal divisor";
+		magnitude.push_back((int32_t)(val >> 32));
 	}
-	int shift = numberOfLeadingZeroes(div.mag[0]);
-	size_t dlen = div.mag.size();
-	std::vector<int32_t> divisor;
-	MutableBigInteger rem;
-	if (shift > 0)
+	if (val != 0)
 	{
-		divisor.assign(dlen, 0);
-		copyAndShift(div.mag, 0, dlen, divisor, 0, shift);
-		if (numberOfLeadingZeroes(this->mag[0]) >= shift)
+		magnitude.push_back((int32_t)val);
+	}
+	return BigInteger(1, magnitude);
+}
+
+size_t BigInteger::levelLength(const std::vector<BigInteger> & level)
+{
+	size_t words = 0;
+	for (auto & node : level)
+	{
+		words += node.mag.size();
+	}
+	return words;
+}
+
+BigInteger BigInteger::strausMultiExp(const std::vector<BigInteger> & bases, const std::vector<BigInteger> & exponents, const BigInteger & m, size_t bits)
+{
+	// Straus: all bases share one chain of squarings, each window then
+	// multiplies in one precomputed power per base. Two bases with one bit
+	// windows is Shamir's trick
+	int width = bits <= 16 ? 1 : bits <= 128 ? 2 : bits <= 1024 ? 4 : 5;
+	std::vector<std::vector<BigInteger>> table(bases.size());
+	for (size_t i = 0; i < bases.size(); i++)
+	{
+		table[i].push_back(1);
+		table[i].push_back(bases[i]);
+		for (int j = 2; j < 1 << width; j++)
 		{
-			rem.value.assign(this->mag.size() + 1, 0);
-			rem.intLen = this->mag.size();
-			rem.offset = 1;
-			copyAndShift(this->mag, 0, this->mag.size(), rem.value, 1, shift);
+			table[i].push_back((table[i][j - 1] * bases[i]).mod(m));
 		}
-		else
+	}
+	size_t windows = (bits + width - 1) / width;
+	BigInteger result = 1;
+	for (size_t w = windows; w-- > 0; )
+	{
+		if (w + 1 < windows)
 		{
-			rem.value.assign(this->mag.size() + 2, 0);
-			rem.intLen = this->mag.size() + 1;
-			rem.offset = 1;
-			size_t rFrom = 0;
-			int32_t c = 0;
-			int n2 = 32 - shift;
-			for (size_t i = 1; i < this->mag.size() + 1; i++, rFrom++)
+			for (int k = 0; k < width; k++)
 			{
-				int32_t b = c;
-				c = this->mag[rFrom];
-				rem.value[i] = (b << shift) | ((uint32_t)c >> n2);
+				result = (result * result).mod(m);
+			}
+		}
+		for (size_t i = 0; i < bases.size(); i++)
+		{
+			int digit = exponents[i].bitWindow(w * width, width);
+			if (digit != 0)
+			{
+				result = (result * table[i][digit]).mod(m);
 			}
-			rem.value[this->mag.size() + 1] = c << shift;
 		}
 	}
-	else
-	{
-		divisor = div.mag;
-		rem.value.insert(rem.value.begin(), this->mag.begin(), this->mag.end());
-		rem.value.insert(rem.value.begin(), 0);
-		rem.intLen = this->mag.size();
-		rem.offset = 1;
-	}
-	size_t nlen = rem.intLen;
-	size_t limit = nlen - dlen + 1;
-	MutableBigInteger q;
-	q.value.assign(limit, 0);
-	q.offset = 0;
-	q.intLen = limit;
-	if (rem.intLen == nlen)
-	{
-		rem.offset = 0;
-		rem.value[0] = 0;
-		rem.intLen++;
-	}
-	const int32_t dh = divisor[0];
-	const uint32_t dhLong = (uint32_t)dh;
-	const uint32_t dl = (uint32_t)divisor[1];
-	for (size_t j = 0; j < limit - 1; j++)
-	{
-		int32_t qhat = 0;
-		int32_t qrem = 0;
-		bool skipCorrection = false;
-		int32_t nh = rem.value[j + rem.offset];
-		int32_t nm = rem.value[j + 1 + rem.offset];
-		if (nh == dh)
+	return result;
+}
+
+BigInteger BigInteger::pippengerMultiExp(const std::vector<BigInteger> & bases, const std::vector<BigInteger> & exponents, const BigInteger & m, size_t bits)
+{
+	// Pippenger: for every window, bucket the bases by their digit, then
+	// the product of bucket[j]^j falls out of two running products
+	int width = std::max(2, bitLengthForInt((int32_t)bases.size()) - 3);
+	size_t windows = (bits + width - 1) / width;
+	BigInteger result = 1;
+	for (size_t w = windows; w-- > 0; )
+	{
+		for (int k = 0; k < width && w + 1 < windows; k++)
 		{
-			qhat = ~(int32_t)0;
-			qrem = nh + nm;
-			skipCorrection = (uint32_t)qrem < (uint32_t)nh;
+			result = (result * result).mod(m);
 		}
-		else
+		std::vector<BigInteger> buckets(1 << width, 1);
+		std::vector<bool> used(buckets.size());
+		for (size_t i = 0; i < bases.size(); i++)
 		{
-			int64_t nChunk = (((int64_t)nh) << 32) | (uint32_t)nm;
-			if (nChunk >= 0)
+			int digit = exponents[i].bitWindow(w * width, width);
+			if (digit != 0)
 			{
-				qhat = (int32_t)(nChunk / dhLong);
-				qrem = (int32_t)(nChunk - (qhat * dhLong));
+				buckets[digit] = used[digit] ? (buckets[digit] * bases[i]).mod(m) : bases[i];
+				used[digit] = true;
 			}
-			else
+		}
+		BigInteger running = 1;
+		BigInteger window = 1;
+		bool started = false;
+		for (size_t j = buckets.size(); j-- > 1; )
+		{
+			if (used[j])
+			{
+				running = started ? (running * buckets[j]).mod(m) : buckets[j];
+				started = true;
+			}
+			if (started)
 			{
-				int64_t tmp = divWord(nChunk, dh);
-				qhat = (int32_t)tmp;
-				qrem = (int32_t)((uint64_t)tmp >> 32);
+				window = (window * running).mod(m);
 			}
 		}
-		if (qhat == 0)
+		result = (result * window).mod(m);
+	}
+	return result;
+}
+
+void BigInteger::forEachNode(size_t count, size_t words, const std::function<void(size_t)> & body)
+{
+	std::shared_ptr<ThreadPool> pool = threadPool();
+	if (!pool || words < PARALLEL_LEVEL_THRESHOLD || count < 2)
+	{
+		for (size_t i = 0; i < count; i++)
 		{
-			continue;
+			body(i);
 		}
-		if (!skipCorrection)
+		return;
+	}
+	// Nodes of one level are independent, hand them out one at a time so a
+	// thread that drew small nodes keeps pulling work
+	std::atomic<size_t> next(0);
+	std::exception_ptr error;
+	std::mutex errorLock;
+	auto worker = [&]
+	{
+		try
 		{
-			uint32_t nl = (uint32_t)rem.value[j + 2 + rem.offset];
-			uint64_t rs = ((uint64_t)(uint32_t)qrem << 32) | nl;
-			uint64_t estProduct = (uint64_t)dl * (uint32_t)qhat;
-			if (estProduct > rs)
+			for (size_t i; (i = next++) < count; )
 			{
-				qhat--;
-				qrem = (int32_t)((uint32_t)qrem + dhLong);
-				if ((uint32_t)qrem >= dhLong)
-				{
-					estProduct -= dl;
-					rs = ((uint64_t)(uint32_t)qrem << 32) | nl;
-					if (estProduct >= rs)
-					{
-						qhat--;
-					}
-				}
+				body(i);
 			}
 		}
-		rem.value[j + rem.offset] = 0;
-		int32_t borrow = mulsub(rem.value, divisor, qhat, dlen, j + rem.offset);
-		if ((uint32_t)borrow > (uint32_t)nh)
+		catch (...)
 		{
-			divadd(divisor, rem.value, j + 1 + rem.offset);
-			qhat--;
+			std::lock_guard<std::mutex> lock(errorLock);
+			error = std::current_exception();
+			next = count;
 		}
-		q.value[j] = qhat;
+	};
+	pool->invoke(std::vector<std::function<void()>>(std::min(count, pool->size() + 1), worker));
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+size_t BigInteger::runCount(size_t count)
+{
+	std::shared_ptr<ThreadPool> pool = threadPool();
+	return std::min(count, pool ? pool->size() : (size_t)1);
+}
+
+void BigInteger::forEachRun(size_t runs, size_t count, size_t words, const std::function<void(size_t, size_t, size_t)> & body)
+{
+	std::vector<std::function<void()>> tasks;
+	for (size_t run = 0; run < runs; run++)
+	{
+		size_t from = count * run / runs, to = count * (run + 1) / runs;
+		tasks.push_back([&body, run, from, to]
+		{
+			body(run, from, to);
+		});
+	}
+	forkJoin(words, tasks);
+}
+
+BigInteger BigInteger::sumOf(const std::vector<const BigInteger *> & values)
+{
+	size_t words = 0;
+	for (const BigInteger * value : values)
+	{
+		words += value->mag.size();
 	}
-	int32_t qhat = 0;
-	int32_t qrem = 0;
-	bool skipCorrection = false;
-	int32_t nh = rem.value[limit - 1 + rem.offset];
-	int32_t nm = rem.value[limit + rem.offset];
-	if (nh == dh)
+	size_t runs = runCount(values.size());
+	std::vector<Columns> positive(runs), negative(runs);
+	forEachRun(runs, values.size(), words, [&](size_t run, size_t from, size_t to)
+	{
+		for (size_t i = from; i < to; i++)
+		{
+			const BigInteger & value = *values[i];
+			if (value.signum != 0)
+			{
+				(value.signum > 0 ? positive[run] : negative[run]).add(value.mag.data(), value.mag.size());
+			}
+		}
+	});
+	return resolve(positive, negative);
+}
+
+BigInteger BigInteger::productOf(const std::vector<const BigInteger *> & values)
+{
+	if (values.empty())
 	{
-		qhat = ~(int32_t)0;
-		qrem = nh + nm;
-		skipCorrection = (uint32_t)qrem < (uint32_t)nh;
+		return 1;
 	}
-	else
+	size_t words = 0;
+	for (const BigInteger * value : values)
 	{
-		int64_t nChunk = (((int64_t)nh) << 32) | (uint32_t)nm;
-		if (nChunk >= 0)
-		{
-			qhat = (int32_t)(nChunk / dhLong);
-			qrem = (int32_t)(nChunk - (qhat * dhLong));
-		}
-		else
+		if (value->signum == 0)
 		{
-			int64_t tmp = divWord(nChunk, dh);
-			qhat = (int32_t)tmp;
-			qrem = (int32_t)((uint64_t)tmp >> 32);
+			return 0;
 		}
+		words += value->mag.size();
 	}
-	if (qhat != 0)
+	// only the level being formed and the one below it are ever held
+	std::vector<BigInteger> level((values.size() + 1) / 2);
+	forEachNode(level.size(), words, [&](size_t i)
 	{
-		if (!skipCorrection)
+		level[i] = 2 * i + 1 < values.size() ? *values[2 * i] * *values[2 * i + 1] : *values[2 * i];
+	});
+	while (level.size() > 1)
+	{
+		std::vector<BigInteger> next((level.size() + 1) / 2);
+		forEachNode(next.size(), levelLength(level), [&](size_t i)
 		{
-			uint32_t nl = (uint32_t)rem.value[limit + 1 + rem.offset];
-			uint64_t rs = ((uint64_t)(uint32_t)qrem << 32) | nl;
-			uint64_t estProduct = (uint64_t)dl * (uint32_t)qhat;
-			if (estProduct > rs)
-			{
-				qhat--;
-				qrem = (int32_t)((uint32_t)qrem + dhLong);
-				if ((uint32_t)qrem >= dhLong)
-				{
-					estProduct -= dl;
-					rs = ((uint64_t)(uint32_t)qrem << 32) | nl;
-					if (estProduct >= rs)
-					{
-						qhat--;
-					}
-				}
-			}
-		}
-		rem.value[limit - 1 + rem.offset] = 0;
-		int32_t borrow = mulsub(rem.value, divisor, qhat, dlen, limit - 1 + rem.offset);
-		if ((uint32_t)borrow > (uint32_t)nh) {
-			divadd(divisor, rem.value, limit - 1 + 1 + rem.offset);
-			qhat--;
-		}
-		q.value[limit - 1] = qhat;
+			next[i] = 2 * i + 1 < level.size() ? level[2 * i] * level[2 * i + 1] : level[2 * i];
+		});
+		level = std::move(next);
 	}
-	quotient = q.toBigInteger();
-	return rem.toBigInteger() >> shift;
+	return level[0];
 }
 
-BigInteger BigInteger::multiplyByInt(const std::vector<int32_t> x, int32_t y, int sign)
+BigInteger BigInteger::resolve(std::vector<Columns> & positive, std::vector<Columns> & negative)
 {
-	if (bitCount(y) == 1)
+	std::vector<int32_t> mag;
+	int sign = 0;
+	for (size_t run = 0; run < positive.size(); run++)
 	{
-		return BigInteger(sign, shiftLeft(x, numberOfTrailingZeroes(y)));
+		std::vector<int32_t> p = positive[run].magnitude(), n = negative[run].magnitude();
+		sign = accumulate(mag, sign, p.data(), p.size(), p.empty() ? 0 : 1);
+		sign = accumulate(mag, sign, n.data(), n.size(), n.empty() ? 0 : -1);
 	}
-	size_t xlen = x.size();
-	std::vector<int32_t> rmag(xlen + 1, 0);
-	int64_t carry = 0;
-	uint32_t y1 = (uint32_t)y;
-	size_t rstart = rmag.size() - 1;
-	for (size_t i = xlen; i-- > 0; )
+	trimLeadingZeroInts(mag);
+	if (mag.empty())
 	{
-		int64_t product = (int64_t)(uint32_t)x[i] * y1 + carry;
-		rmag[rstart--] = (int32_t)product;
-		carry = (uint64_t)product >> 32;
+		return 0;
 	}
-	if (carry == 0)
+	return BigInteger(sign, std::move(mag));
+}
+
+void BigInteger::forkJoin(size_t words, const std::vector<std::function<void()>> & tasks)
+{
+	std::shared_ptr<ThreadPool> pool = threadPool();
+	if (pool && words >= PARALLEL_MULTIPLY_THRESHOLD)
 	{
-		rmag.erase(rmag.begin());
+		pool->invoke(tasks);
+		return;
 	}
-	else
+	for (auto & task : tasks)
 	{
-		rmag[rstart] = (int32_t)carry;
+		task();
 	}
-	return BigInteger(sign, rmag);
 }
 
-std::vector<int32_t> BigInteger::multiplyToLen(const std::vector<int32_t> x, size_t xlen, const std::vector<int32_t> y, size_t ylen)
+std::vector<int32_t> BigInteger::multiplyToLen(const std::vector<int32_t> & x, size_t xlen, const std::vector<int32_t> & y, size_t ylen)
+{
+	COUNT_PATH(MULTIPLY_TO_LEN, xlen + ylen);
+	std::vector<int32_t> z(xlen + ylen);
+	LimbKernels::multiply(x.data(), xlen, y.data(), ylen, z.data());
+	return z;
+}
+
+void BigInteger::copyAndShift(const int32_t * src, size_t srcLen, int32_t * dst, int shift)
+{
+	LimbKernels::shiftLeft(dst, src, srcLen - 1, shift);
+	dst[srcLen - 1] = (int32_t)((uint32_t)src[srcLen - 1] << shift);
+}
+
+uint64_t BigInteger::divWord(uint64_t n, int32_t d)
+{
+	// the caller guarantees the high word of n is below d, so the quotient
+	// fits in the low word of the result and the remainder in the high word
+	uint32_t dLong = (uint32_t)d;
+	uint64_t q = n / dLong;
+	uint64_t r = n - q * dLong;
+	return (r << 32) | (uint32_t)q;
+}
+
+uint32_t BigInteger::reciprocal(uint32_t d)
+{
+	// floor((2^64 - 1) / d) lies in [2^32, 2^33), and its low word is
+	// the reciprocal less 2^32 that the division steps expect
+	return (uint32_t)(UINT64_MAX / d);
+}
+
+uint32_t BigInteger::reciprocal(uint32_t d1, uint32_t d0)
 {
-	size_t xstart = xlen - 1;
-	size_t ystart = ylen;
-	std::vector<int32_t> z(xlen + ylen, 0);
-	int64_t carry = 0;
-	for (size_t j = ystart, k = ystart + 1 + xstart; j-- > 0; )
+	// the reciprocal of d1 alone, corrected for d0
+	uint32_t v = reciprocal(d1);
+	uint32_t p = d1 * v + d0;
+	if (p < d0)
 	{
-		int64_t product = (int64_t)(uint32_t)y[j] * (uint32_t)x[xstart] + carry;
-		z[--k] = (int32_t)product;
-		carry = (uint64_t)product >> 32;
+		v--;
+		if (p >= d1)
+		{
+			v--;
+			p -= d1;
+		}
+		p -= d1;
 	}
-	z[xstart] = (int32_t)carry;
-	for (size_t i = xstart; i-- > 0; )
+	uint64_t t = (uint64_t)v * d0;
+	uint32_t t1 = (uint32_t)(t >> 32);
+	p += t1;
+	if (p < t1)
 	{
-		carry = 0;
-		for (size_t j = ystart, k = ystart + 1 + i; j-- > 0; )
+		v--;
+		if ((((uint64_t)p << 32) | (uint32_t)t) >= (((uint64_t)d1 << 32) | d0))
 		{
-			int64_t product = (int64_t)(uint32_t)y[j] * (uint32_t)x[i] + (uint32_t)z[--k] + carry;
-			z[k] = (int32_t)product;
-			carry = (uint64_t)product >> 32;
+			v--;
 		}
-		z[i] = (int32_t)carry;
 	}
-	return z;
+	return v;
 }
 
-void BigInteger::copyAndShift(const std::vector<int32_t> & src, size_t srcFrom, size_t srcLen, std::vector<int32_t> & dst, size_t dstFrom, int shift)
+uint32_t BigInteger::divide2by1(uint32_t u1, uint32_t u0, uint32_t d, uint32_t v, uint32_t & r)
 {
-	int n2 = 32 - shift;
-	int32_t c = src[srcFrom];
-	for (size_t i = 0; i < srcLen - 1; i++)
+	// the estimate from the reciprocal is at most one too small, and a
+	// wrong guess in the other direction shows up as a remainder past q0
+	uint64_t p = (uint64_t)v * u1 + (((uint64_t)u1 << 32) | u0);
+	uint32_t q1 = (uint32_t)(p >> 32) + 1, q0 = (uint32_t)p;
+	r = u0 - q1 * d;
+	if (r > q0)
+	{
+		q1--;
+		r += d;
+	}
+	if (r >= d)
 	{
-		int32_t b = c;
-		c = src[++srcFrom];
-		dst[dstFrom + i] = (b << shift) | ((uint32_t)c >> n2);
+		q1++;
+		r -= d;
 	}
-	dst[dstFrom + srcLen - 1] = c << shift;
+	return q1;
 }
 
-int64_t BigInteger::divWord(int64_t n, int32_t d)
+uint32_t BigInteger::divide3by2(uint32_t u2, uint32_t u1, uint32_t u0, uint64_t d, uint32_t v, uint64_t & r)
 {
-	uint32_t dLong = (uint32_t)d;
-	int64_t r;
-	int64_t q;
-	if (dLong == 1)
+	uint32_t d1 = (uint32_t)(d >> 32), d0 = (uint32_t)d;
+	uint64_t p = (uint64_t)v * u2 + (((uint64_t)u2 << 32) | u1);
+	uint32_t q1 = (uint32_t)(p >> 32), q0 = (uint32_t)p;
+	uint32_t r1 = u1 - q1 * d1;
+	r = (((uint64_t)r1 << 32) | u0) - (uint64_t)d0 * q1 - d;
+	q1++;
+	if ((uint32_t)(r >> 32) >= q0)
 	{
-		q = (int32_t)n;
-		r = 0;
-		return ((uint64_t)r << 32) | (uint32_t)q;
+		q1--;
+		r += d;
 	}
-	q = (int64_t)(((uint64_t)n >> 1) / (dLong >> 1));
-	r = n - q * dLong;
-	while (r < 0)
+	if (r >= d)
 	{
-		r += dLong;
-		q--;
+		q1++;
+		r -= d;
 	}
-	while (r >= dLong)
-	{
-		r -= dLong;
-		q++;
+	return q1;
+}
+
+uint32_t BigInteger::divideByInt(const int32_t * x, size_t len, uint32_t d, int32_t * q)
+{
+	// the divisor is normalized to its top bit and the dividend shifted
+	// with it a word at a time, which leaves the quotient unchanged
+	int shift = numberOfLeadingZeroes((int32_t)d);
+	d <<= shift;
+	uint32_t v = reciprocal(d);
+	uint32_t r = (uint32_t)((uint64_t)(uint32_t)x[0] >> (32 - shift));
+	for (size_t i = 0; i < len; i++)
+	{
+		uint32_t next = i + 1 < len ? (uint32_t)x[i + 1] : 0;
+		uint32_t u = (uint32_t)((((uint64_t)(uint32_t)x[i] << 32) | next) >> (32 - shift));
+		uint32_t digit = divide2by1(r, u, d, v, r);
+		if (q != nullptr)
+		{
+			q[i] = (int32_t)digit;
+		}
 	}
-	return ((uint64_t)r << 32) | q;
+	return r >> shift;
 }
 
-int32_t BigInteger::mulsub(std::vector<int32_t> & q, std::vector<int32_t> & a, int32_t x, size_t len, size_t offset)
+uint64_t BigInteger::divideByLong(const int32_t * x, size_t len, uint64_t d, int32_t * q)
 {
-	uint32_t xLong = (uint32_t)x;
-	int64_t carry = 0;
-	offset += len;
-	for (size_t j = len; j-- > 0; )
-	{
-		int64_t product = (uint64_t)(uint32_t)a[j] * xLong + carry;
-		int64_t difference = q[offset] - product;
-		q[offset--] = (int32_t)difference;
-		carry = ((uint64_t)product >> 32) + (((uint32_t)difference) > ((uint64_t)(uint32_t)(~(int32_t)product)) ? 1 : 0);
+	int shift = numberOfLeadingZeroes((int32_t)(d >> 32));
+	d <<= shift;
+	uint32_t v = reciprocal((uint32_t)(d >> 32), (uint32_t)d);
+	uint64_t r = (uint64_t)(uint32_t)x[0] >> (32 - shift);
+	for (size_t i = 0; i < len; i++)
+	{
+		uint32_t next = i + 1 < len ? (uint32_t)x[i + 1] : 0;
+		uint32_t u = (uint32_t)((((uint64_t)(uint32_t)x[i] << 32) | next) >> (32 - shift));
+		uint32_t digit = divide3by2((uint32_t)(r >> 32), (uint32_t)r, u, d, v, r);
+		if (q != nullptr)
+		{
+			q[i] = (int32_t)digit;
+		}
 	}
-	return (int32_t)carry;
+	return r >> shift;
+}
+
+int32_t BigInteger::mulsub(int32_t * q, const int32_t * a, int32_t x, size_t len, size_t offset)
+{
+	return LimbKernels::mulsub(q + offset + 1, a, x, len);
 }
 
-int32_t BigInteger::mulsubBorrow(std::vector<int32_t> & q, std::vector<int32_t> & a, int32_t x, size_t len, size_t offset)
+int32_t BigInteger::mulsubBorrow(const int32_t * q, const int32_t * a, int32_t x, size_t len, size_t offset)
 {
 	uint32_t xLong = (uint32_t)x;
-	int64_t carry = 0;
+	uint64_t carry = 0;
 	offset += len;
 	for (size_t j = len; j-- > 0; )
 	{
-		int64_t product = (uint64_t)(uint32_t)a[j] * xLong + carry;
-		int64_t difference = q[offset--] - product;
-		carry = ((uint64_t)product >> 32) + (((uint64_t)difference) > (uint64_t)(~(int32_t)product) ? 1 : 0);
+		uint64_t product = (uint64_t)(uint32_t)a[j] * xLong + carry;
+		uint32_t difference = (uint32_t)q[offset--] - (uint32_t)product;
+		carry = (product >> 32) + (difference > ~(uint32_t)product ? 1 : 0);
 	}
 	return (int32_t)carry;
 }
 
-int32_t BigInteger::divadd(std::vector<int32_t> & a, std::vector<int32_t> & result, size_t offset)
+int32_t BigInteger::divadd(const int32_t * a, size_t len, int32_t * result, size_t offset)
 {
-	int64_t carry = 0;
-	for (auto j = a.size(); j-- > 0; )
+	uint64_t carry = 0;
+	for (size_t j = len; j-- > 0; )
 	{
-		int64_t sum = (uint64_t)(uint32_t)a[j] + (uint32_t)result[j + offset] + carry;
+		uint64_t sum = (uint64_t)(uint32_t)a[j] + (uint32_t)result[j + offset] + carry;
 		result[j + offset] = (int32_t)sum;
-		carry = (uint64_t)sum >> 32;
+		carry = sum >> 32;
 	}
 	return (int32_t)carry;
 }
@@ -1078,19 +2582,12 @@ std::ostream & operator<<(std::ostream & output, const BigInteger & value)
 	return output << value.toString();
 }
 
-void BigInteger::toString(const BigInteger & u, std::string & sb, int radix, size_t digits)
+void BigInteger::toString(const BigInteger & u, std::string & sb, int radix, size_t digits, size_t threshold)
 {
-	if (u.mag.size() <= SCHOENHAGE_BASE_CONVERSION_THRESHOLD)
+	if (u.mag.size() <= threshold)
 	{
-		std::string s = u.smallToString(radix);
-		if (s.size() < digits && sb.size() > 0)
-		{
-			for (auto i = s.size(); i < digits; i++)
-			{
-				sb.append("0");
-			}
-		}
-		sb.append(s);
+		// the most significant group is never padded
+		u.smallToString(radix, sb, sb.empty() ? 0 : digits);
 		return;
 	}
 	size_t b = u.bitLength();
@@ -1099,20 +2596,26 @@ void BigInteger::toString(const BigInteger & u, std::string & sb, int radix, siz
 	BigInteger q;
 	BigInteger r = u.divide(v, q);
 	int expectedDigits = 1 << n;
-	toString(q, sb, radix, digits - expectedDigits);
-	toString(r, sb, radix, expectedDigits);
+	toString(q, sb, radix, digits - expectedDigits, threshold);
+	toString(r, sb, radix, expectedDigits, threshold);
 }
 
 BigInteger BigInteger::getRadixConversionCache(int radix, int exponent)
 {
-	std::vector<BigInteger> cacheLine = POWER_CACHE[radix];
-	if ((size_t)exponent >= cacheLine.size())
+	// radix^(2^i) at index i, squared out as conversions ask for them. The
+	// lines are built by the first conversion rather than at startup
+	static std::vector<BigInteger> powerCache[MAX_RADIX + 1];
+	static std::mutex powerCacheLock;
+	std::lock_guard<std::mutex> lock(powerCacheLock);
+	std::vector<BigInteger> & cacheLine = powerCache[radix];
+	if (cacheLine.empty())
 	{
-		for (auto i = cacheLine.size(); i <= (size_t)exponent; i++)
-		{
-			// shift as pow(2) shortcut
-			cacheLine[i] = cacheLine[i - 1] << 1;
-		}
+		cacheLine.push_back(radix);
+	}
+	while (cacheLine.size() <= (size_t)exponent)
+	{
+		// radix^(2^i) is the square of the previous entry
+		cacheLine.push_back(cacheLine.back() * cacheLine.back());
 	}
 	return cacheLine[exponent];
 }
@@ -1123,31 +2626,18 @@ std::vector<int32_t> BigInteger::add(const std::vector<int32_t> & x, const std::
 	{
 		return add(y, x);
 	}
-	size_t xIndex = x.size();
-	size_t yIndex = y.size();
-	std::vector<int32_t> result(xIndex);
-	int64_t sum = 0;
-	if (yIndex == 1)
-	{
-		sum = (uint32_t)x[--xIndex] + (uint32_t)y[0];
-		result[xIndex] = (int32_t)sum;
-	}
-	else
-	{
-		while (yIndex > 0)
-		{
-			sum = (int64_t)(uint32_t)x[--xIndex] + (uint32_t)y[--yIndex] + ((uint64_t)sum >> 32);
-			result[xIndex] = (int32_t)sum;
-		}
-	}
-	bool carry = ((uint64_t)sum >> 32) != 0;
+	size_t xIndex = x.size() - y.size();
+	std::vector<int32_t> result(x.size());
+	bool carry = LimbKernels::add(result.data() + xIndex, x.data() + xIndex, y.data(), y.size()) != 0;
 	while (xIndex > 0 && carry)
 	{
-		carry = (result[--xIndex] = x[xIndex] + 1) == 0;
+		xIndex--;
+		carry = (result[xIndex] = x[xIndex] + 1) == 0;
 	}
 	while (xIndex > 0)
 	{
-		result[--xIndex] = x[xIndex];
+		xIndex--;
+		result[xIndex] = x[xIndex];
 	}
 	if (carry)
 	{
@@ -1158,23 +2648,18 @@ std::vector<int32_t> BigInteger::add(const std::vector<int32_t> & x, const std::
 
 std::vector<int32_t> BigInteger::subtract(const std::vector<int32_t> & big, const std::vector<int32_t> & little)
 {
-	size_t bigIndex = big.size();
-	std::vector<int32_t> result(bigIndex);
-	size_t littleIndex = little.size();
-	int64_t difference = 0;
-	while (littleIndex > 0)
-	{
-		difference = (int64_t)(uint32_t)big[--bigIndex] - (uint32_t)little[--littleIndex] + (difference >> 32);
-		result[bigIndex] = (int32_t)difference;
-	}
-	bool borrow = (difference >> 32) != 0;
+	size_t bigIndex = big.size() - little.size();
+	std::vector<int32_t> result(big.size());
+	bool borrow = LimbKernels::subtract(result.data() + bigIndex, big.data() + bigIndex, little.data(), little.size()) != 0;
 	while (bigIndex > 0 && borrow)
 	{
-		borrow = ((result[--bigIndex] = big[bigIndex] - 1) == -1);
+		bigIndex--;
+		borrow = ((result[bigIndex] = big[bigIndex] - 1) == -1);
 	}
 	while (bigIndex > 0)
 	{
-		result[--bigIndex] = big[bigIndex];
+		bigIndex--;
+		result[bigIndex] = big[bigIndex];
 	}
 	return result;
 }
@@ -1204,16 +2689,65 @@ std::vector<int32_t> BigInteger::shiftLeft(std::vector<int32_t> mag, int32_t n)
 		{
 			newMag.assign(magLen + nInts, 0);
 		}
-		size_t j = 0;
-		while (j < magLen - 1)
-		{
-			newMag[i++] = mag[j++] << nBits | (uint32_t)mag[j] >> nBits2;
-		}
-		newMag[i] = mag[j] << nBits;
+		LimbKernels::shiftLeft(newMag.data() + i, mag.data(), magLen - 1, nBits);
+		newMag[i + magLen - 1] = (int32_t)((uint32_t)mag[magLen - 1] << nBits);
 	}
 	return newMag;
 }
 
+std::vector<int32_t> BigInteger::andMagnitude(const std::vector<int32_t> & x, const std::vector<int32_t> & y)
+{
+	size_t len = std::min(x.size(), y.size());
+	std::vector<int32_t> result(len);
+	LimbKernels::bitwise(LimbKernels::AND, result.data(), x.data() + x.size() - len, y.data() + y.size() - len, len);
+	return result;
+}
+
+std::vector<int32_t> BigInteger::orMagnitude(const std::vector<int32_t> & x, const std::vector<int32_t> & y)
+{
+	if (x.size() < y.size())
+	{
+		return orMagnitude(y, x);
+	}
+	std::vector<int32_t> result = x;
+	size_t from = x.size() - y.size();
+	LimbKernels::bitwise(LimbKernels::OR, result.data() + from, result.data() + from, y.data(), y.size());
+	return result;
+}
+
+std::vector<int32_t> BigInteger::xorMagnitude(const std::vector<int32_t> & x, const std::vector<int32_t> & y)
+{
+	if (x.size() < y.size())
+	{
+		return xorMagnitude(y, x);
+	}
+	std::vector<int32_t> result = x;
+	size_t from = x.size() - y.size();
+	LimbKernels::bitwise(LimbKernels::XOR, result.data() + from, result.data() + from, y.data(), y.size());
+	return result;
+}
+
+std::vector<int32_t> BigInteger::andNotMagnitude(const std::vector<int32_t> & x, const std::vector<int32_t> & y)
+{
+	std::vector<int32_t> result = x;
+	size_t len = std::min(x.size(), y.size());
+	size_t from = x.size() - len;
+	LimbKernels::bitwise(LimbKernels::AND_NOT, result.data() + from, result.data() + from, y.data() + y.size() - len, len);
+	return result;
+}
+
+std::vector<int32_t> BigInteger::widenToBit(const std::vector<int32_t> & x, int32_t n)
+{
+	size_t len = ((uint32_t)n >> 5) + 1;
+	if (x.size() >= len)
+	{
+		return x;
+	}
+	std::vector<int32_t> result(len - x.size(), 0);
+	result.insert(result.end(), x.begin(), x.end());
+	return result;
+}
+
 std::vector<int32_t> BigInteger::makePositive(const std::vector<int32_t> & a)
 {
 	size_t keep, j;
@@ -1236,6 +2770,261 @@ std::vector<int32_t> BigInteger::stripLeadingZeroInts(const std::vector<int32_t>
 	return std::vector<int32_t>(val.begin() + keep, val.end());
 }
 
+void BigInteger::trimLeadingZeroInts(std::vector<int32_t> & val)
+{
+	size_t keep;
+	for (keep = 0; keep < val.size() && val[keep] == 0; keep++);
+	val.erase(val.begin(), val.begin() + keep);
+}
+
+std::vector<int32_t> BigInteger::multiplyMagnitudes(const BigInteger & a, const BigInteger & b)
+{
+	if (a.signum == 0 || b.signum == 0)
+	{
+		return std::vector<int32_t>();
+	}
+	if (a.mag.size() >= KARATSUBA_THRESHOLD && b.mag.size() >= KARATSUBA_THRESHOLD)
+	{
+		return multiplyKaratsuba(a, b).mag;
+	}
+	return multiplyToLen(a.mag, a.mag.size(), b.mag, b.mag.size());
+}
+
+int BigInteger::accumulate(std::vector<int32_t> & x, int xsign, const int32_t * y, size_t ylen, int ysign)
+{
+	if (ysign == 0)
+	{
+		return xsign;
+	}
+	if (xsign == 0)
+	{
+		x.assign(y, y + ylen);
+		return ysign;
+	}
+	int cmp = xsign == ysign ? 1 : compareWords(x.data(), x.size(), y, ylen);
+	if (cmp == 0)
+	{
+		x.clear();
+		return 0;
+	}
+	if (x.size() < ylen)
+	{
+		x.insert(x.begin(), ylen - x.size(), 0);
+	}
+	size_t xlen = x.size();
+	if (xsign == ysign)
+	{
+		// past the end of y only the carry is left to ripple
+		uint64_t carry = 0;
+		for (size_t k = 0; k < xlen && (k < ylen || carry != 0); k++)
+		{
+			uint64_t sum = (uint64_t)(uint32_t)x[xlen - 1 - k] + (k < ylen ? (uint32_t)y[ylen - 1 - k] : 0) + carry;
+			x[xlen - 1 - k] = (int32_t)sum;
+			carry = sum >> 32;
+		}
+		if (carry != 0)
+		{
+			x.insert(x.begin(), (int32_t)carry);
+		}
+		return xsign;
+	}
+	if (cmp > 0)
+	{
+		int64_t borrow = 0;
+		for (size_t k = 0; k < xlen && (k < ylen || borrow != 0); k++)
+		{
+			int64_t difference = (int64_t)(uint32_t)x[xlen - 1 - k] - (k < ylen ? (uint32_t)y[ylen - 1 - k] : 0) + borrow;
+			x[xlen - 1 - k] = (int32_t)difference;
+			borrow = difference >> 32;
+		}
+		return xsign;
+	}
+	// y is the larger, so the difference runs the other way across every word
+	int64_t borrow = 0;
+	for (size_t k = 0; k < xlen; k++)
+	{
+		int64_t difference = (int64_t)(k < ylen ? (uint32_t)y[ylen - 1 - k] : 0) - (uint32_t)x[xlen - 1 - k] + borrow;
+		x[xlen - 1 - k] = (int32_t)difference;
+		borrow = difference >> 32;
+	}
+	return ysign;
+}
+
+void BigInteger::Columns::add(const int32_t * x, size_t len)
+{
+	// after a carry every column is below 2^32, and the columns and the
+	// carries between them both stay below (k + 1) 2^32 after k more words
+	if (this->pending == UINT32_MAX - 1)
+	{
+		carry();
+	}
+	if (this->sums.size() < len)
+	{
+		this->sums.resize(len, 0);
+	}
+	for (size_t i = 0; i < len; i++)
+	{
+		this->sums[i] += (uint32_t)x[len - 1 - i];
+	}
+	this->pending++;
+}
+
+void BigInteger::Columns::add(uint64_t word)
+{
+	if (this->pending == UINT32_MAX - 1)
+	{
+		carry();
+	}
+	if (this->sums.size() < 2)
+	{
+		this->sums.resize(2, 0);
+	}
+	this->sums[0] += (uint32_t)word;
+	this->sums[1] += word >> 32;
+	this->pending++;
+}
+
+void BigInteger::Columns::add(Columns & other)
+{
+	other.carry();
+	if (this->pending == UINT32_MAX - 1)
+	{
+		carry();
+	}
+	if (this->sums.size() < other.sums.size())
+	{
+		this->sums.resize(other.sums.size(), 0);
+	}
+	for (size_t i = 0; i < other.sums.size(); i++)
+	{
+		this->sums[i] += other.sums[i];
+	}
+	this->pending++;
+}
+
+void BigInteger::Columns::carry()
+{
+	uint64_t c = 0;
+	for (uint64_t & column : this->sums)
+	{
+		uint64_t t = column + c;
+		column = (uint32_t)t;
+		c = t >> 32;
+	}
+	if (c != 0)
+	{
+		this->sums.push_back(c);
+	}
+	this->pending = 0;
+}
+
+std::vector<int32_t> BigInteger::Columns::magnitude()
+{
+	carry();
+	std::vector<int32_t> mag(this->sums.size());
+	for (size_t i = 0; i < this->sums.size(); i++)
+	{
+		mag[mag.size() - 1 - i] = (int32_t)this->sums[i];
+	}
+	trimLeadingZeroInts(mag);
+	return mag;
+}
+
+int BigInteger::compareWords(const std::vector<int32_t> & x, const std::vector<int32_t> & y)
+{
+	return compareWords(x.data(), x.size(), y.data(), y.size());
+}
+
+int BigInteger::compareWords(const int32_t * x, size_t xlen, const int32_t * y, size_t ylen)
+{
+	size_t i = 0, j = 0;
+	while (i < xlen && x[i] == 0)
+	{
+		i++;
+	}
+	while (j < ylen && y[j] == 0)
+	{
+		j++;
+	}
+	if (xlen - i != ylen - j)
+	{
+		return xlen - i < ylen - j ? -1 : 1;
+	}
+	for (; i < xlen; i++, j++)
+	{
+		if (x[i] != y[j])
+		{
+			return (uint32_t)x[i] < (uint32_t)y[j] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+BigInteger BigInteger::multiplyAccumulate(const BigInteger & a, const BigInteger & b, const BigInteger & c, const BigInteger & d, int sign)
+{
+	std::vector<int32_t> z, w;
+	forkJoin(a.mag.size() + b.mag.size() + c.mag.size() + d.mag.size(),
+	{
+		[&] { z = multiplyMagnitudes(a, b); },
+		[&] { w = multiplyMagnitudes(c, d); }
+	});
+	int result = accumulate(z, a.signum * b.signum, w.data(), w.size(), sign * c.signum * d.signum);
+	trimLeadingZeroInts(z);
+	return BigInteger(result, std::move(z));
+}
+
+// the 128 bit product of a and b folded to 64 bits, after wyhash
+static inline uint64_t foldedMultiply(uint64_t a, uint64_t b)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	uint64_t high;
+	uint64_t low = _umul128(a, b, &high);
+	return low ^ high;
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 t = (unsigned __int128)a * b;
+	return (uint64_t)t ^ (uint64_t)(t >> 64);
+#else
+	uint64_t ll = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF), lh = (a & 0xFFFFFFFF) * (b >> 32);
+	uint64_t hl = (a >> 32) * (b & 0xFFFFFFFF), hh = (a >> 32) * (b >> 32);
+	uint64_t mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+	return ((ll & 0xFFFFFFFF) | mid << 32) ^ (hh + (lh >> 32) + (hl >> 32) + (mid >> 32));
+#endif
+}
+
+uint64_t BigInteger::hashWords(int signum, const int32_t * words, size_t len)
+{
+	static const uint64_t PRIMES[] = { 0xA0761D6478BD642Full, 0xE7037ED1A0B428DBull, 0x8EBC6AF09C88C6E3ull, 0x589965CC75374CC3ull };
+	static const uint32_t KEYS[] = { 0x78BD642F, 0xA0761D64, 0xA0B428DB, 0xE7037ED1, 0x9C88C6E3, 0x8EBC6AF0, 0x75374CC3, 0x589965CC };
+	uint64_t acc[4] = { PRIMES[0], PRIMES[1], PRIMES[2], PRIMES[3] };
+	size_t k = 0;
+	// Stripes of eight words feed four independent lanes, each adding a
+	// 32 by 32 bit product of its two keyed words and the words themselves,
+	// so the lanes run side by side in vector registers. The lanes are
+	// scrambled every 16 stripes so long inputs keep their high bits mixed
+	while (k + 8 <= len)
+	{
+		for (size_t end = std::min(len - len % 8, k + 128); k < end; k += 8)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				uint32_t a = (uint32_t)words[k + 2 * j], b = (uint32_t)words[k + 2 * j + 1];
+				acc[j] += (uint64_t)(a ^ KEYS[2 * j]) * (b ^ KEYS[2 * j + 1]) + ((uint64_t)a << 32 | b);
+			}
+		}
+		for (int j = 0; j < 4; j++)
+		{
+			acc[j] = (acc[j] ^ acc[j] >> 47) * 0x9E3779B1;
+		}
+	}
+	uint64_t h = foldedMultiply(acc[0] ^ PRIMES[1], acc[1] ^ PRIMES[2]) ^ foldedMultiply(acc[2] ^ PRIMES[3], acc[3] ^ PRIMES[0]);
+	for (; k < len; k += 2)
+	{
+		uint64_t w = (uint64_t)(uint32_t)words[k] << 32 | (k + 1 < len ? (uint32_t)words[k + 1] : 0);
+		h = foldedMultiply(w ^ PRIMES[1], h ^ PRIMES[0]);
+	}
+	return foldedMultiply(h ^ PRIMES[2], ((uint64_t)len << 2 | (uint64_t)(signum + 1)) ^ PRIMES[3]);
+}
+
 int BigInteger::bitLengthForInt(int32_t i)
 {
 	return 32 - numberOfLeadingZeroes(i);
@@ -1247,6 +3036,13 @@ int BigInteger::numberOfLeadingZeroes(int32_t i)
 	{
 		return 32;
 	}
+#if defined(__GNUC__)
+	return __builtin_clz((uint32_t)i);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse(&index, (uint32_t)i);
+	return 31 - (int)index;
+#else
 	int n = 1;
 	if ((uint32_t)i >> 16 == 0) { n += 16; i <<= 16; }
 	if ((uint32_t)i >> 24 == 0) { n += 8; i <<= 8; }
@@ -1254,21 +3050,30 @@ int BigInteger::numberOfLeadingZeroes(int32_t i)
 	if ((uint32_t)i >> 30 == 0) { n += 2; i <<= 2; }
 	n -= (uint32_t)i >> 31;
 	return n;
+#endif
 }
 
 int BigInteger::numberOfTrailingZeroes(int32_t i)
 {
-	int y;
 	if (i == 0)
 	{
 		return 32;
 	}
+#if defined(__GNUC__)
+	return __builtin_ctz((uint32_t)i);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, (uint32_t)i);
+	return (int)index;
+#else
+	int y;
 	int n = 31;
 	y = i << 16; if (y != 0) { n = n - 16; i = y; }
 	y = i << 8; if (y != 0) { n = n - 8; i = y; }
 	y = i << 4; if (y != 0) { n = n - 4; i = y; }
 	y = i << 2; if (y != 0) { n = n - 2; i = y; }
 	return n - ((uint32_t)(i << 1) >> 31);
+#endif
 }
 
 int BigInteger::bitCount(int32_t i)
@@ -1340,54 +3145,10 @@ int32_t BigInteger::stringToInt(std::string s, int radix)
 	return negative ? result : -result;
 }
 
-std::string BigInteger::longToString(int64_t i, int radix)
-{
-	static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
-	if (radix < MIN_RADIX || radix > MAX_RADIX)
-	{
-		radix = 10;
-	}
-	std::string buf;
-	bool negative = i < 0;
-	if (!negative)
-	{
-		i = -i;
-	}
-	while (i <= -radix)
-	{
-		buf.insert(buf.begin(), digits[-(i % radix)]);
-		i /= radix;
-	}
-	buf.insert(buf.begin(), digits[-i]);
-	if (negative)
-	{
-		buf.insert(buf.begin(), '-');
-	}
-	return buf;
-}
-
 void BigInteger::destructiveMulAdd(std::vector<int32_t> & x, int32_t y, int32_t z)
 {
-	uint32_t ylong = (uint32_t)y;
-	uint32_t zlong = (uint32_t)z;
-	size_t len = x.size();
-	int64_t product = 0;
-	int64_t carry = 0;
-	for (size_t i = len; i-- > 0; )
-	{
-		product = (int64_t)ylong * (uint32_t)x[i] + carry;
-		x[i] = (int32_t)product;
-		carry = (uint64_t)product >> 32;
-	}
-	int64_t sum = (int64_t)(uint32_t)x[len - 1] + zlong;
-	x[len - 1] = (int32_t)sum;
-	carry = (uint64_t)carry >> 32;
-	for (size_t i = len - 1; i-- > 0; )
-	{
-		sum = (int64_t)(uint32_t)x[i] + carry;
-		x[i] = (int32_t)sum;
-		carry = (uint64_t)sum >> 32;
-	}
+	// the word carried out is dropped, the callers having made room for it
+	LimbKernels::multiplyAdd(x.data(), x.size(), y, z);
 }
 
 int BigInteger::charToDigit(char ch, int radix)
@@ -4,16 +4,59 @@
 
 #pragma once
 
+#include <functional>
 #include <inttypes.h>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <vector>
 
+#include "biginteger_tuning.h"
+#include "magnitude.h"
+
+class ThreadPool;
+
 class BigInteger
 {
 public:
 	static const int MIN_RADIX = 2, MAX_RADIX = 36;
 
+	// Counts of which algorithm served each call, summed over all threads.
+	// Counting is compiled in with -DBIGINTEGER_STATS, otherwise every field
+	// stays zero. Magnitude allocations count each new magnitude a
+	// BigInteger takes ownership of, and bytes the capacity it holds; copies
+	// share the words they were made from and are not counted
+	struct Stats
+	{
+		enum Path
+		{
+			MULTIPLY_BY_INT,
+			MULTIPLY_TO_LEN,
+			MULTIPLY_KARATSUBA,
+			DIVIDE_ONE_WORD,
+			DIVIDE_MAGNITUDE,
+			DIVIDE_BURNIKEL_ZIEGLER,
+			SMALL_TO_STRING,
+			SCHOENHAGE_TO_STRING,
+			PATH_COUNT
+		};
+
+		static const bool ENABLED;
+
+		uint64_t calls[PATH_COUNT];
+
+		uint64_t words[PATH_COUNT];
+
+		uint64_t allocations;
+
+		uint64_t allocatedBytes;
+
+		static const char * pathName(Path path);
+	};
+
 	BigInteger(int64_t val = 0);
 
 	BigInteger(const BigInteger & other);
@@ -48,12 +91,230 @@ public:
 
 	BigInteger operator>>(int32_t n) const;
 
+	BigInteger operator&(const BigInteger & rhs) const;
+
+	BigInteger operator|(const BigInteger & rhs) const;
+
+	BigInteger operator^(const BigInteger & rhs) const;
+
+	BigInteger operator~() const;
+
 	BigInteger & operator=(BigInteger rhs);
 
+	BigInteger & operator+=(const BigInteger & rhs);
+
+	BigInteger & operator-=(const BigInteger & rhs);
+
+	BigInteger & operator*=(const BigInteger & rhs);
+
+	BigInteger & operator/=(const BigInteger & rhs);
+
+	BigInteger & operator%=(const BigInteger & rhs);
+
+	// Integer operands of any width go straight to the single word kernels
+	// as a sign and a 64 bit magnitude, so mixed arithmetic and comparison
+	// never build a BigInteger for them
+	template <typename T>
+	using Word = typename std::enable_if<std::is_integral<T>::value, typename std::conditional<std::is_signed<T>::value, int64_t, uint64_t>::type>::type;
+
+	template <typename T, typename W = Word<T>>
+	BigInteger & operator+=(T rhs)
+	{
+		return addWord(signOf(rhs), magnitudeOf(rhs));
+	}
+
+	template <typename T, typename W = Word<T>>
+	BigInteger & operator-=(T rhs)
+	{
+		return addWord(-signOf(rhs), magnitudeOf(rhs));
+	}
+
+	template <typename T, typename W = Word<T>>
+	BigInteger & operator*=(T rhs)
+	{
+		return *this = multiplyWord(signOf(rhs), magnitudeOf(rhs));
+	}
+
+	template <typename T, typename W = Word<T>>
+	BigInteger & operator/=(T rhs)
+	{
+		BigInteger quotient;
+		divideWord(signOf(rhs), magnitudeOf(rhs), quotient);
+		this->signum = quotient.signum;
+		this->mag.swap(quotient.mag);
+		return *this;
+	}
+
+	template <typename T, typename W = Word<T>>
+	BigInteger & operator%=(T rhs)
+	{
+		return *this = valueOf(this->signum, remainderWord(magnitudeOf(rhs)));
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend BigInteger operator+(const BigInteger & lhs, T rhs)
+	{
+		BigInteger result(lhs);
+		result.addWord(signOf(rhs), magnitudeOf(rhs));
+		return result;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend BigInteger operator+(T lhs, const BigInteger & rhs)
+	{
+		return rhs + lhs;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend BigInteger operator-(const BigInteger & lhs, T rhs)
+	{
+		BigInteger result(lhs);
+		result.addWord(-signOf(rhs), magnitudeOf(rhs));
+		return result;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend BigInteger operator-(T lhs, const BigInteger & rhs)
+	{
+		BigInteger result = -rhs;
+		result.addWord(signOf(lhs), magnitudeOf(lhs));
+		return result;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend BigInteger operator*(const BigInteger & lhs, T rhs)
+	{
+		return lhs.multiplyWord(signOf(rhs), magnitudeOf(rhs));
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend BigInteger operator*(T lhs, const BigInteger & rhs)
+	{
+		return rhs.multiplyWord(signOf(lhs), magnitudeOf(lhs));
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend BigInteger operator/(const BigInteger & lhs, T rhs)
+	{
+		BigInteger quotient;
+		lhs.divideWord(signOf(rhs), magnitudeOf(rhs), quotient);
+		return quotient;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend BigInteger operator%(const BigInteger & lhs, T rhs)
+	{
+		return valueOf(lhs.signum, lhs.remainderWord(magnitudeOf(rhs)));
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator<(const BigInteger & lhs, T rhs)
+	{
+		return lhs.compareWord(signOf(rhs), magnitudeOf(rhs)) < 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator<(T lhs, const BigInteger & rhs)
+	{
+		return rhs.compareWord(signOf(lhs), magnitudeOf(lhs)) > 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator>(const BigInteger & lhs, T rhs)
+	{
+		return lhs.compareWord(signOf(rhs), magnitudeOf(rhs)) > 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator>(T lhs, const BigInteger & rhs)
+	{
+		return rhs.compareWord(signOf(lhs), magnitudeOf(lhs)) < 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator<=(const BigInteger & lhs, T rhs)
+	{
+		return lhs.compareWord(signOf(rhs), magnitudeOf(rhs)) <= 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator<=(T lhs, const BigInteger & rhs)
+	{
+		return rhs.compareWord(signOf(lhs), magnitudeOf(lhs)) >= 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator>=(const BigInteger & lhs, T rhs)
+	{
+		return lhs.compareWord(signOf(rhs), magnitudeOf(rhs)) >= 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator>=(T lhs, const BigInteger & rhs)
+	{
+		return rhs.compareWord(signOf(lhs), magnitudeOf(lhs)) <= 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator==(const BigInteger & lhs, T rhs)
+	{
+		return lhs.compareWord(signOf(rhs), magnitudeOf(rhs)) == 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator==(T lhs, const BigInteger & rhs)
+	{
+		return rhs.compareWord(signOf(lhs), magnitudeOf(lhs)) == 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator!=(const BigInteger & lhs, T rhs)
+	{
+		return lhs.compareWord(signOf(rhs), magnitudeOf(rhs)) != 0;
+	}
+
+	template <typename T, typename W = Word<T>>
+	friend bool operator!=(T lhs, const BigInteger & rhs)
+	{
+		return rhs.compareWord(signOf(lhs), magnitudeOf(lhs)) != 0;
+	}
+
 	BigInteger abs() const;
 
+	BigInteger andNot(const BigInteger & val) const;
+
+	bool testBit(int32_t n) const;
+
+	BigInteger setBit(int32_t n) const;
+
+	BigInteger clearBit(int32_t n) const;
+
+	BigInteger flipBit(int32_t n) const;
+
+	int bitCount() const;
+
 	BigInteger divide(const BigInteger & val, BigInteger & quotient) const;
 
+	// this / divisor truncated into quotient, returning the magnitude of the
+	// remainder, which takes the sign of this
+	uint64_t divRemWord(uint64_t divisor, BigInteger & quotient) const;
+
+	// this mod divisor, never negative, found without forming a quotient
+	uint64_t modWord(uint64_t divisor) const;
+
+	// this / val for a val known to divide this exactly, worked from the
+	// least significant end so no remainder is ever formed; other operands
+	// give a meaningless quotient, which debug builds catch by throwing
+	BigInteger divideExact(const BigInteger & val) const;
+
+	BigInteger gcd(const BigInteger & val) const;
+
+	BigInteger mod(const BigInteger & m) const;
+
+	BigInteger modInverse(const BigInteger & m) const;
+
+	BigInteger modPow(const BigInteger & exponent, const BigInteger & m) const;
+
 	std::string toString() const;
 
 	std::string toString(int radix) const;
@@ -62,6 +323,123 @@ public:
 
 	size_t bitLength() const;
 
+	// the nearest double, ties to even, or an infinity past the range
+	double toDouble() const;
+
+	// the integer part of a finite value, throwing for an infinity or NaN
+	static BigInteger fromDouble(double value);
+
+	// Conversions with the built in integer types, including __int128 where
+	// the compiler has it, made straight from the low words. from is exact
+	// for every value, and to is exact when fitsIn says so, keeping the low
+	// bits in two's complement as a cast would otherwise
+#if defined(__SIZEOF_INT128__)
+	template <typename T>
+	using Integer = typename std::enable_if<std::numeric_limits<T>::is_integer, typename std::conditional<(sizeof(T) > 8), unsigned __int128, uint64_t>::type>::type;
+#else
+	template <typename T>
+	using Integer = typename std::enable_if<std::numeric_limits<T>::is_integer, uint64_t>::type;
+#endif
+
+	template <typename T, typename U = Integer<T>>
+	static BigInteger from(T value)
+	{
+		int sign = signOf(value);
+		U magnitude = sign < 0 ? 0 - (U)value : (U)value;
+		std::vector<int32_t> words(sizeof(U) / 4);
+		for (size_t i = words.size(); i-- > 0; )
+		{
+			words[i] = (int32_t)magnitude;
+			magnitude >>= 32;
+		}
+		return BigInteger(sign, stripLeadingZeroInts(words));
+	}
+
+	template <typename T, typename U = Integer<T>>
+	T to() const
+	{
+		U bits = 0;
+		size_t len = this->mag.size();
+		for (size_t i = len < sizeof(U) / 4 ? len : sizeof(U) / 4; i > 0; i--)
+		{
+			bits = bits << 32 | (uint32_t)this->mag[len - i];
+		}
+		return (T)(this->signum < 0 ? 0 - bits : bits);
+	}
+
+	template <typename T, typename U = Integer<T>>
+	bool fitsIn() const
+	{
+		return (std::numeric_limits<T>::is_signed || this->signum >= 0) && bitLength() <= (size_t)std::numeric_limits<T>::digits;
+	}
+
+	// agrees with ==, and is the same for a BigIntegerView of equal value
+	size_t hashCode() const;
+
+	static BigInteger factorial(int32_t n);
+
+	static BigInteger binomial(int32_t n, int32_t k);
+
+	static BigInteger productRange(int64_t a, int64_t b);
+
+	static std::vector<std::vector<BigInteger>> productTree(const std::vector<BigInteger> & values);
+
+	static std::vector<BigInteger> remainders(const BigInteger & x, const std::vector<BigInteger> & moduli);
+
+	static std::vector<BigInteger> remainders(const BigInteger & x, const std::vector<std::vector<BigInteger>> & tree);
+
+	static std::vector<BigInteger> batchGcd(const std::vector<BigInteger> & values);
+
+	static BigInteger multiExp(const std::vector<BigInteger> & bases, const std::vector<BigInteger> & exponents, const BigInteger & m);
+
+	// Reductions over a range of BigIntegers, split into one run per thread
+	// of the pool when one is set. A sum adds every magnitude into 64 bit
+	// columns and moves their carries once at the end, and a product
+	// multiplies neighbours level by level so each multiplication is
+	// between operands of similar size
+
+	template <typename Iterator>
+	static BigInteger sum(Iterator first, Iterator last)
+	{
+		return sumOf(addresses(first, last));
+	}
+
+	template <typename Iterator>
+	static BigInteger product(Iterator first, Iterator last)
+	{
+		return productOf(addresses(first, last));
+	}
+
+	// the sum of a[i] * b[i]
+	static BigInteger dot(const std::vector<BigInteger> & a, const std::vector<BigInteger> & b);
+
+	// Fused forms of common expressions, each product is formed once and the
+	// rest is accumulated into it in place, with a single normalization
+	// instead of one per intermediate result
+
+	// a * b + c
+	static BigInteger fma(const BigInteger & a, const BigInteger & b, const BigInteger & c);
+
+	// a * b + c * d
+	static BigInteger mulAdd(const BigInteger & a, const BigInteger & b, const BigInteger & c, const BigInteger & d);
+
+	// a * b - c * d
+	static BigInteger mulSub(const BigInteger & a, const BigInteger & b, const BigInteger & c, const BigInteger & d);
+
+	// (a + b) mod m, as cheap as a subtraction when both are already reduced
+	static BigInteger addMod(const BigInteger & a, const BigInteger & b, const BigInteger & m);
+
+	// counts since the last reset, which a true argument also performs
+	static Stats stats(bool reset = false);
+
+	// Very large multiplications, the divisions built on them, and the
+	// levels of product and remainder trees split their independent parts
+	// across the given pool. Without one, the default, they run on the
+	// calling thread
+	static void setThreadPool(std::shared_ptr<ThreadPool> pool);
+
+	static std::shared_ptr<ThreadPool> threadPool();
+
 	friend std::istream & operator>>(std::istream & input, BigInteger & value);
 
 	friend std::ostream & operator<<(std::ostream & output, const BigInteger & value);
@@ -69,86 +447,172 @@ public:
 	~BigInteger();
 
 private:
+	friend class MultiModular;
+
+	friend class BigIntegerBatch;
+
+	friend class BigIntegerView;
+
+	friend class BigIntegerVector;
+
+	friend class BigAccumulator;
+
+	friend class BigIntegerTuner;
+
+	friend class LimbKernels;
+
+	template <size_t Bits>
+	friend class FixedBigInt;
+
+	static const int SCHOENHAGE_BASE_CONVERSION_THRESHOLD = TUNED_SCHOENHAGE_BASE_CONVERSION_THRESHOLD;
+
+	static const int KNUTH_POW2_THRESH_LEN = TUNED_KNUTH_POW2_THRESH_LEN;
+
+	static const int KNUTH_POW2_THRESH_ZEROS = TUNED_KNUTH_POW2_THRESH_ZEROS;
 
-	static const int SCHOENHAGE_BASE_CONVERSION_THRESHOLD = 20;
+	static const int PRODUCT_LEAF_LENGTH = 16;
 
-	static const int KNUTH_POW2_THRESH_LEN = 6;
+	static const size_t PARALLEL_LEVEL_THRESHOLD = 8192;
 
-	static const int KNUTH_POW2_THRESH_ZEROS = 3;
+	static const size_t PIPPENGER_THRESHOLD = 32;
 
-	static const std::vector<std::vector<BigInteger>> POWER_CACHE;
+	static const size_t KARATSUBA_THRESHOLD = TUNED_KARATSUBA_THRESHOLD;
 
-	static const std::vector<double> LOG_CACHE;
+	static const size_t BURNIKEL_ZIEGLER_THRESHOLD = TUNED_BURNIKEL_ZIEGLER_THRESHOLD;
 
-	static const double LOG_TWO;
+	static const size_t BURNIKEL_ZIEGLER_OFFSET = 40;
 
-	static const int DIGITS_PER_LONG[];
+	static const size_t PARALLEL_MULTIPLY_THRESHOLD = TUNED_PARALLEL_MULTIPLY_THRESHOLD;
 
-	static const BigInteger LONG_RADIX[];
+	// where setThreadPool keeps the pool, made on first use so that starting
+	// the program runs nothing for it
+	static std::shared_ptr<ThreadPool> & poolSlot();
 
-	static const int DIGITS_PER_INT[];
+	static constexpr int EXP_MOD_THRESHOLDS[] = { 7, 25, 81, 241, 673, 1793, INT32_MAX };
 
-	static const int INT_RADIX[];
+	// The radix tables are constants of the compiled program, so nothing is
+	// computed or allocated for them when it starts
 
-	static const std::vector<std::string> ZEROES;
+	// log(radix)
+	static constexpr double LOG_CACHE[] = { 0, 0,
+		0.69314718055994529, 1.0986122886681098, 1.3862943611198906, 1.6094379124341003,
+		1.791759469228055, 1.9459101490553132, 2.0794415416798357, 2.1972245773362196,
+		2.3025850929940459, 2.3978952727983707, 2.4849066497880004, 2.5649493574615367,
+		2.6390573296152584, 2.7080502011022101, 2.7725887222397811, 2.8332133440562162,
+		2.8903717578961645, 2.9444389791664403, 2.9957322735539909, 3.044522437723423,
+		3.0910424533583161, 3.1354942159291497, 3.1780538303479458, 3.2188758248682006,
+		3.2580965380214821, 3.2958368660043291, 3.3322045101752038, 3.3672958299864741,
+		3.4011973816621555, 3.4339872044851463, 3.4657359027997265, 3.4965075614664802,
+		3.5263605246161616, 3.5553480614894135, 3.5835189384561099
+	};
+
+	static constexpr double LOG_TWO = 0.69314718055994529;
+
+	static constexpr int DIGITS_PER_LONG[] = { 0, 0,
+		62, 39, 31, 27, 24, 22, 20, 19, 18, 18, 17, 17, 16, 16, 15, 15, 15, 14,
+		14, 14, 14, 13, 13, 13, 13, 13, 13, 12, 12, 12, 12, 12, 12, 12, 12
+	};
+
+	// radix^DIGITS_PER_LONG[radix]
+	static constexpr uint64_t LONG_RADIX[] = { 0, 0,
+		0x4000000000000000, 0x383d9170b85ff80b,
+		0x4000000000000000, 0x6765c793fa10079d,
+		0x41c21cb8e1000000, 0x3642798750226111,
+		0x1000000000000000, 0x12bf307ae81ffd59,
+		 0xde0b6b3a7640000, 0x4d28cb56c33fa539,
+		0x1eca170c00000000, 0x780c7372621bd74d,
+		0x1e39a5057d810000, 0x5b27ac993df97701,
+		0x1000000000000000, 0x27b95e997e21d9f1,
+		0x5da0e1e53c5c8000,  0xb16a458ef403f19,
+		0x16bcc41e90000000, 0x2d04b7fdd9c0ef49,
+		0x5658597bcaa24000,  0x6feb266931a75b7,
+		 0xc29e98000000000, 0x14adf4b7320334b9,
+		0x226ed36478bfa000, 0x383d9170b85ff80b,
+		0x5a3c23e39c000000,  0x4e900abb53e6b71,
+		 0x7600ec618141000,  0xaee5720ee830681,
+		0x1000000000000000, 0x172588ad4f5f0981,
+		0x211e44f7d02c1000, 0x2ee56725f06e5c71,
+		0x41c21cb8e1000000
+	};
+
+	static constexpr int DIGITS_PER_INT[] = { 0, 0,
+		30, 19, 15, 13, 11, 11, 10, 9, 9, 8, 8, 8, 8, 7, 7, 7, 7, 7,
+		7, 7, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 5
+	};
+
+	static constexpr int INT_RADIX[] = { 0, 0,
+		0x40000000, 0x4546b3db, 0x40000000, 0x48c27395, 0x159fd800,
+		0x75db9c97, 0x40000000, 0x17179149, 0x3b9aca00 , 0xcc6db61,
+		0x19a10000, 0x309f1021, 0x57f6c100,  0xa2f1b6f, 0x10000000,
+		0x18754571, 0x247dbc80, 0x3547667b, 0x4c4b4000, 0x6b5a6e1d,
+		 0x6c20a40,  0x8d2d931,  0xb640000,  0xe8d4a51, 0x1269ae40,
+		0x17179149, 0x1cb91000, 0x23744899, 0x2b73a840, 0x34e63b41,
+		0x40000000, 0x4cfa3cc1, 0x5c13d840, 0x6d91b519,  0x39aa400
+	};
 
-	static const size_t BITS_PER_DIGIT[];
+	static constexpr size_t BITS_PER_DIGIT[] = { 0, 0,
+		1024, 1624, 2048, 2378, 2648, 2875, 3072, 3247, 3402, 3543, 3672,
+		3790, 3899, 4001, 4096, 4186, 4271, 4350, 4426, 4498, 4567, 4633,
+		4696, 4756, 4814, 4870, 4923, 4975, 5025, 5074, 5120, 5166, 5210,
+		5253, 5295
+	};
 
-	class MutableBigInteger
+	// Per-thread stack of words for the working storage of division and
+	// base conversion. Words taken inside a Frame stay valid until the Frame
+	// ends and are then reused by the next one, so once a thread has warmed
+	// up, those algorithms allocate nothing but their results
+	class Scratch
 	{
 	public:
-		std::vector<int32_t> value;
+		class Frame
+		{
+		public:
+			Frame();
 
-		size_t intLen;
+			~Frame();
 
-		size_t offset;
+			// len zeroed words
+			int32_t * take(size_t len);
 
-		void normalize()
-		{
-			if (this->intLen == 0)
-			{
-				this->offset = 0;
-				return;
-			}
-			size_t index = this->offset;
-			if (this->value[index] != 0)
-			{
-				return;
-			}
-			size_t indexBound = index + this->intLen;
-			do {
-				index++;
-			} while (index < indexBound && this->value[index] == 0);
-			size_t numZeros = index - this->offset;
-			this->intLen -= numZeros;
-			this->offset = this->intLen == 0 ? 0 : this->offset + numZeros;
-		}
+		private:
+			Scratch & scratch;
 
-		BigInteger toBigInteger()
-		{
-			normalize();
-			if (this->intLen == 0)
-			{
-				return 0;
-			}
-			return BigInteger(1, std::vector<int32_t>(this->value.begin() + this->offset, this->value.begin() + this->offset + this->intLen));
-		}
+			size_t block;
+
+			size_t used;
+		};
+
+	private:
+		std::vector<std::unique_ptr<int32_t[]>> blocks;
+
+		std::vector<size_t> sizes;
+
+		size_t block = 0;
+
+		size_t used = 0;
+
+		static Scratch & local();
 	};
 
 	int signum;
 
-	std::vector<int32_t> mag;
+	Magnitude mag;
 
 	BigInteger(std::vector<int32_t> & val);
 
 	BigInteger(int signum, std::vector<int32_t> magnitude);
 
+	// shares the words of an existing magnitude
+	BigInteger(int signum, const Magnitude & magnitude);
+
 	BigInteger withSign(int sign) const;
 
 	int32_t getInt(size_t n) const;
 
 	int getLowestSetBit() const;
 
+	int bitWindow(size_t from, int width) const;
+
 	int compare(const BigInteger & rhs) const;
 
 	int compareMagnitude(const BigInteger & rhs) const;
@@ -157,27 +621,167 @@ private:
 
 	std::string smallToString(int radix) const;
 
+	// appends the digits to buf, padded with leading zeros to digits
+	void smallToString(int radix, std::string & buf, size_t digits) const;
+
+	// the same for the big-endian words of a magnitude, which are divided
+	// away in place
+	static void smallToString(int signum, int32_t * words, size_t len, int radix, std::string & buf, size_t digits);
+
 	BigInteger divideKnuth(const BigInteger & val, BigInteger & quotient) const;
 
-	int32_t divideOneWord(int32_t divisor, BigInteger & quotient) const;
+	BigInteger divideShifted(const BigInteger & val, BigInteger & quotient, int trailingZeroBits) const;
 
 	BigInteger divideMagnitude(const BigInteger & div, BigInteger & quotient) const;
 
-	static BigInteger multiplyByInt(const std::vector<int32_t> x, int32_t y, int sign);
+	BigInteger divideSchoolbook(const BigInteger & div, BigInteger & quotient) const;
+
+	BigInteger divideBurnikelZiegler(const BigInteger & div, BigInteger & quotient) const;
+
+	// q with q * d = a mod 2^(32 n) for odd d, given inverse = d^-1 mod 2^32
+	static BigInteger divideHensel(const BigInteger & a, const BigInteger & d, size_t n, uint32_t inverse);
+
+	BigInteger getLower(size_t n) const;
+
+	BigInteger getUpper(size_t n) const;
+
+	BigInteger getBlock(size_t index, size_t length) const;
+
+	static BigInteger multiplyByInt(const std::vector<int32_t> & x, int32_t y, int sign);
+
+	static BigInteger multiplyByLong(const std::vector<int32_t> & x, uint64_t y, int sign);
+
+	BigInteger & addWord(int sign, uint64_t magnitude);
+
+	BigInteger multiplyWord(int sign, uint64_t magnitude) const;
+
+	// the magnitude of the remainder is returned
+	uint64_t divideWord(int sign, uint64_t magnitude, BigInteger & quotient) const;
+
+	// |this| mod divisor
+	uint64_t remainderWord(uint64_t divisor) const;
+
+	int compareWord(int sign, uint64_t magnitude) const;
+
+	// only meaningful while the magnitude holds at most two words
+	uint64_t wordMagnitude() const;
+
+	static BigInteger valueOf(int sign, uint64_t magnitude);
+
+	template <typename T>
+	static int signOf(T value)
+	{
+		return value > 0 ? 1 : value == 0 ? 0 : -1;
+	}
+
+	// negating in unsigned arithmetic keeps the most negative value exact
+	template <typename T>
+	static uint64_t magnitudeOf(T value)
+	{
+		return signOf(value) < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+	}
+
+	static BigInteger multiplyKaratsuba(const BigInteger & x, const BigInteger & y);
+
+	static void divide2n1n(const BigInteger & a, const BigInteger & b, size_t n, BigInteger & quotient, BigInteger & remainder);
+
+	static void divide3n2n(const BigInteger & a12, const BigInteger & a3, const BigInteger & b, const BigInteger & b1, const BigInteger & b2, size_t n, BigInteger & quotient, BigInteger & remainder);
+
+	static void forkJoin(size_t words, const std::vector<std::function<void()>> & tasks);
+
+	static BigInteger multiplyRange(uint64_t lo, uint64_t hi, uint64_t step);
+
+	static BigInteger multiplyFactors(const std::vector<uint64_t> & factors, size_t from, size_t to);
+
+	static BigInteger valueOfWord(uint64_t val);
+
+	static size_t levelLength(const std::vector<BigInteger> & level);
+
+	static BigInteger strausMultiExp(const std::vector<BigInteger> & bases, const std::vector<BigInteger> & exponents, const BigInteger & m, size_t bits);
+
+	static BigInteger pippengerMultiExp(const std::vector<BigInteger> & bases, const std::vector<BigInteger> & exponents, const BigInteger & m, size_t bits);
+
+	static void forEachNode(size_t count, size_t words, const std::function<void(size_t)> & body);
+
+	// the runs to split count items into, one per thread of the pool
+	static size_t runCount(size_t count);
+
+	// body(run, from, to) for each of the given runs over count items
+	static void forEachRun(size_t runs, size_t count, size_t words, const std::function<void(size_t, size_t, size_t)> & body);
+
+	// 64 bit sums of 32 bit words, least significant first, whose carries
+	// are only moved up when another word could overflow a column
+	struct Columns
+	{
+		std::vector<uint64_t> sums;
+
+		uint32_t pending = 0;
+
+		// adds big-endian words
+		void add(const int32_t * x, size_t len);
+
+		void add(uint64_t word);
+
+		// adds the sums other holds, carrying them first
+		void add(Columns & other);
+
+		void carry();
+
+		// the words with their carries moved, most significant first
+		std::vector<int32_t> magnitude();
+	};
+
+	template <typename Iterator>
+	static std::vector<const BigInteger *> addresses(Iterator first, Iterator last)
+	{
+		std::vector<const BigInteger *> values;
+		for (; first != last; ++first)
+		{
+			values.push_back(&*first);
+		}
+		return values;
+	}
+
+	static BigInteger sumOf(const std::vector<const BigInteger *> & values);
+
+	static BigInteger productOf(const std::vector<const BigInteger *> & values);
+
+	// the difference of the positive and negative columns of each run
+	static BigInteger resolve(std::vector<Columns> & positive, std::vector<Columns> & negative);
+
+	static std::vector<int32_t> multiplyToLen(const std::vector<int32_t> & x, size_t xlen, const std::vector<int32_t> & y, size_t ylen);
+
+	static void copyAndShift(const int32_t * src, size_t srcLen, int32_t * dst, int shift);
+
+	static uint64_t divWord(uint64_t n, int32_t d);
+
+	// Granlund and Moeller's reciprocal of a divisor with its top bit set,
+	// which turns each step of a division by it into multiplications
+	static uint32_t reciprocal(uint32_t d);
 
-	static std::vector<int32_t> multiplyToLen(const std::vector<int32_t> x, size_t xlen, const std::vector<int32_t> y, size_t ylen);
+	// the same for a two word divisor d1:d0
+	static uint32_t reciprocal(uint32_t d1, uint32_t d0);
 
-	static void copyAndShift(const std::vector<int32_t> & src, size_t srcFrom, size_t srcLen, std::vector<int32_t> & dst, size_t dstFrom, int shift);
+	// u1:u0 / d given u1 < d, with the remainder in r
+	static uint32_t divide2by1(uint32_t u1, uint32_t u0, uint32_t d, uint32_t v, uint32_t & r);
 
-	static int64_t divWord(int64_t n, int32_t d);
+	// u2:u1:u0 / d given u2:u1 < d, with the remainder in r
+	static uint32_t divide3by2(uint32_t u2, uint32_t u1, uint32_t u0, uint64_t d, uint32_t v, uint64_t & r);
 
-	static int32_t mulsub(std::vector<int32_t> & q, std::vector<int32_t> & a, int32_t x, size_t len, size_t offset);
+	// the big-endian words x / d into q, which may be x itself or null when
+	// only the remainder is wanted; the remainder is returned
+	static uint32_t divideByInt(const int32_t * x, size_t len, uint32_t d, int32_t * q);
 
-	static int32_t mulsubBorrow(std::vector<int32_t> & q, std::vector<int32_t> & a, int32_t x, size_t len, size_t offset);
+	// the same for d of two words
+	static uint64_t divideByLong(const int32_t * x, size_t len, uint64_t d, int32_t * q);
 
-	static int32_t divadd(std::vector<int32_t> & a, std::vector<int32_t> & result, size_t offset);
+	static int32_t mulsub(int32_t * q, const int32_t * a, int32_t x, size_t len, size_t offset);
 
-	static void toString(const BigInteger & u, std::string & sb, int radix, size_t digits);
+	static int32_t mulsubBorrow(const int32_t * q, const int32_t * a, int32_t x, size_t len, size_t offset);
+
+	static int32_t divadd(const int32_t * a, size_t len, int32_t * result, size_t offset);
+
+	static void toString(const BigInteger & u, std::string & sb, int radix, size_t digits, size_t threshold);
 
 	static BigInteger getRadixConversionCache(int radix, int exponent);
 
@@ -187,10 +791,39 @@ private:
 
 	static std::vector<int32_t> shiftLeft(std::vector<int32_t> mag, int32_t n);
 
+	static std::vector<int32_t> andMagnitude(const std::vector<int32_t> & x, const std::vector<int32_t> & y);
+
+	static std::vector<int32_t> orMagnitude(const std::vector<int32_t> & x, const std::vector<int32_t> & y);
+
+	static std::vector<int32_t> xorMagnitude(const std::vector<int32_t> & x, const std::vector<int32_t> & y);
+
+	static std::vector<int32_t> andNotMagnitude(const std::vector<int32_t> & x, const std::vector<int32_t> & y);
+
+	static std::vector<int32_t> widenToBit(const std::vector<int32_t> & x, int32_t n);
+
 	static std::vector<int32_t> makePositive(const std::vector<int32_t> & val);
 
 	static std::vector<int32_t> stripLeadingZeroInts(const std::vector<int32_t> & val);
 
+	static void trimLeadingZeroInts(std::vector<int32_t> & val);
+
+	// the product magnitude, possibly with a leading zero word
+	static std::vector<int32_t> multiplyMagnitudes(const BigInteger & a, const BigInteger & b);
+
+	// adds ysign * y to the magnitude x of sign xsign in place, returning the
+	// sign of the sum, whose magnitude may keep leading zero words
+	static int accumulate(std::vector<int32_t> & x, int xsign, const int32_t * y, size_t ylen, int ysign);
+
+	// compares magnitudes that may carry leading zero words
+	static int compareWords(const std::vector<int32_t> & x, const std::vector<int32_t> & y);
+
+	static int compareWords(const int32_t * x, size_t xlen, const int32_t * y, size_t ylen);
+
+	static BigInteger multiplyAccumulate(const BigInteger & a, const BigInteger & b, const BigInteger & c, const BigInteger & d, int sign);
+
+	// the hash of a value from its sign and big-endian magnitude words
+	static uint64_t hashWords(int signum, const int32_t * words, size_t len);
+
 	static int bitLengthForInt(int32_t i);
 
 	static int numberOfLeadingZeroes(int32_t i);
@@ -201,9 +834,19 @@ private:
 
 	static int32_t stringToInt(std::string s, int radix);
 
-	static std::string longToString(int64_t l, int radix);
-
 	static void destructiveMulAdd(std::vector<int32_t> & x, int32_t y, int32_t z);
 
 	static int charToDigit(char ch, int radix);
 };
+
+namespace std
+{
+	template <>
+	struct hash<BigInteger>
+	{
+		size_t operator()(const BigInteger & value) const
+		{
+			return value.hashCode();
+		}
+	};
+}
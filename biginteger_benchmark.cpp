@@ -0,0 +1,482 @@
+/*
+* Paul Fulham
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <stdio.h>
+
+#include "biginteger.h"
+#include "biginteger_benchmark.h"
+#include "limbkernels.h"
+
+// every heap allocation in the process goes through here, so the benchmark
+// can report allocations per operation without instrumenting the library
+static std::atomic<uint64_t> allocations(0);
+
+void * operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void * p = std::malloc(size == 0 ? 1 : size))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+	std::free(p);
+}
+
+static std::mt19937 generator(0x5EED);
+
+BigInteger randomWords(size_t words)
+{
+	// building from the halves keeps setup at the cost of the shifts rather
+	// than the quadratic cost of appending a word at a time
+	if (words <= 16)
+	{
+		BigInteger result;
+		for (size_t i = 0; i < words; i++)
+		{
+			uint32_t word = generator();
+			if (i == 0)
+			{
+				word |= 0x80000000;
+			}
+			result = (result << 32) + (int64_t)word;
+		}
+		return result;
+	}
+	size_t low = words / 2;
+	return (randomWords(words - low) << (low * 32)) | randomWords(low);
+}
+
+std::vector<Benchmark> benchmarks()
+{
+	std::vector<Benchmark> list
+	{
+		{
+			"add", 0,
+			[](size_t n) { return Operands { randomWords(n), randomWords(n), "" }; },
+			[](const Operands & o) { return (o.a + o.b).bitLength(); }
+		},
+		{
+			"subtract", 0,
+			[](size_t n) { return Operands { randomWords(n), randomWords(n), "" }; },
+			[](const Operands & o) { return (o.a - o.b).bitLength(); }
+		},
+		{
+			"multiply", 0,
+			[](size_t n) { return Operands { randomWords(n), randomWords(n), "" }; },
+			[](const Operands & o) { return (o.a * o.b).bitLength(); }
+		},
+		{
+			"divide", 0,
+			[](size_t n) { return Operands { randomWords(2 * n), randomWords(n), "" }; },
+			[](const Operands & o) { return (o.a / o.b).bitLength(); }
+		},
+		{
+			"mod", 0,
+			[](size_t n) { return Operands { randomWords(2 * n), randomWords(n), "" }; },
+			[](const Operands & o) { return (o.a % o.b).bitLength(); }
+		},
+		{
+			"shiftLeft", 0,
+			[](size_t n) { return Operands { randomWords(n), 0, "" }; },
+			[](const Operands & o) { return (o.a << 37).bitLength(); }
+		},
+		{
+			"shiftRight", 0,
+			[](size_t n) { return Operands { randomWords(n), 0, "" }; },
+			[](const Operands & o) { return (o.a >> 37).bitLength(); }
+		},
+		{
+			// operands differ only in the last word, so the whole magnitude is scanned
+			"compare", 0,
+			[](size_t n) { BigInteger a = randomWords(n); return Operands { a, a + 1, "" }; },
+			[](const Operands & o) { return (size_t)(o.a < o.b); }
+		}
+	};
+	for (int radix : { 10, 16 })
+	{
+		list.push_back({
+			"toString", radix,
+			[](size_t n) { return Operands { randomWords(n), 0, "" }; },
+			[=](const Operands & o) { return o.a.toString(radix).size(); }
+		});
+		list.push_back({
+			"parse", radix,
+			[=](size_t n) { return Operands { 0, 0, randomWords(n).toString(radix) }; },
+			[=](const Operands & o) { return BigInteger(o.text, radix).bitLength(); }
+		});
+	}
+	return list;
+}
+
+std::string key(const std::string & op, int radix, size_t words)
+{
+	return op + "/" + std::to_string(radix) + "/" + std::to_string(words);
+}
+
+Measurement measure(const Benchmark & benchmark, const Operands & operands, size_t words, double minTime)
+{
+	typedef std::chrono::steady_clock clock;
+	volatile size_t sink = 0;
+	uint64_t iterations = 1;
+	while (true)
+	{
+		uint64_t before = allocations.load(std::memory_order_relaxed);
+		clock::time_point start = clock::now();
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			sink = sink + benchmark.run(operands);
+		}
+		double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		uint64_t allocated = allocations.load(std::memory_order_relaxed) - before;
+		if (elapsed >= minTime)
+		{
+			double perOp = elapsed / iterations;
+			return Measurement
+			{
+				benchmark.name, benchmark.radix, words, iterations,
+				perOp * 1e9, words / perOp, (double)allocated / iterations, false
+			};
+		}
+		// aim straight for the time budget once a run is long enough to trust
+		uint64_t next = elapsed > minTime / 100 ? (uint64_t)(iterations * 1.2 * minTime / elapsed) : iterations * 10;
+		iterations = std::max(next, iterations + 1);
+	}
+}
+
+std::vector<Measurement> run(const Options & options)
+{
+	std::vector<Measurement> results;
+	for (const Benchmark & benchmark : benchmarks())
+	{
+		if (!options.ops.empty() && std::find(options.ops.begin(), options.ops.end(), benchmark.name) == options.ops.end())
+		{
+			continue;
+		}
+		Measurement previous {};
+		double exponent = 1;
+		bool skipping = false;
+		for (size_t words = options.minWords; words <= options.maxWords; words *= 2)
+		{
+			// the quadratic operations would run for hours at a million words,
+			// so each size is predicted from the growth measured so far and
+			// skipped once a single operation would exceed the budget
+			if (!skipping && previous.words != 0)
+			{
+				double predicted = previous.nsPerOp * 1e-9 * std::pow((double)words / previous.words, exponent);
+				skipping = predicted > options.maxOpTime;
+			}
+			if (skipping)
+			{
+				results.push_back(Measurement { benchmark.name, benchmark.radix, words, 0, 0, 0, 0, true });
+				continue;
+			}
+			Operands operands = benchmark.setup(words);
+			Measurement m = measure(benchmark, operands, words, options.minTime);
+			// small sizes are dominated by fixed costs, so the growth rate is
+			// only trusted above a microsecond and never assumed sublinear
+			if (previous.words != 0 && previous.nsPerOp > 1000)
+			{
+				exponent = std::max(1.0, std::log(m.nsPerOp / previous.nsPerOp) / std::log((double)words / previous.words));
+			}
+			fprintf(stderr, "%-10s %2d %8zu words %14.1f ns/op\n", m.op.c_str(), m.radix, words, m.nsPerOp);
+			results.push_back(m);
+			previous = m;
+		}
+	}
+	return results;
+}
+
+void writeCsv(std::ostream & out, const std::vector<Measurement> & results)
+{
+	out << "op,radix,words,iterations,ns_per_op,words_per_sec,allocs_per_op,status" << std::endl;
+	for (const Measurement & m : results)
+	{
+		out << m.op << "," << m.radix << "," << m.words << "," << m.iterations << ","
+			<< m.nsPerOp << "," << m.wordsPerSecond << "," << m.allocationsPerOp << ","
+			<< (m.skipped ? "skipped" : "ok") << std::endl;
+	}
+}
+
+void writeJson(std::ostream & out, const std::vector<Measurement> & results)
+{
+	out << "[" << std::endl;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Measurement & m = results[i];
+		out << "  {\"op\": \"" << m.op << "\", \"radix\": " << m.radix << ", \"words\": " << m.words
+			<< ", \"iterations\": " << m.iterations << ", \"ns_per_op\": " << m.nsPerOp
+			<< ", \"words_per_sec\": " << m.wordsPerSecond << ", \"allocs_per_op\": " << m.allocationsPerOp
+			<< ", \"status\": \"" << (m.skipped ? "skipped" : "ok") << "\"}"
+			<< (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "]" << std::endl;
+}
+
+std::string jsonField(const std::string & line, const std::string & name)
+{
+	std::string pattern = "\"" + name + "\": ";
+	size_t start = line.find(pattern);
+	if (start == std::string::npos)
+	{
+		return "";
+	}
+	start += pattern.size();
+	if (line[start] == '"')
+	{
+		return line.substr(start + 1, line.find('"', start + 1) - start - 1);
+	}
+	return line.substr(start, line.find_first_of(",}", start) - start);
+}
+
+// reads back either format written above, one result per line
+Baseline readBaseline(const std::string & path)
+{
+	std::ifstream in(path);
+	if (!in)
+	{
+		throw "Cannot open baseline";
+	}
+	Baseline baseline;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		Measurement m {};
+		std::string status;
+		if (line.find('{') != std::string::npos)
+		{
+			m.op = jsonField(line, "op");
+			m.radix = std::atoi(jsonField(line, "radix").c_str());
+			m.words = std::strtoull(jsonField(line, "words").c_str(), nullptr, 10);
+			m.nsPerOp = std::atof(jsonField(line, "ns_per_op").c_str());
+			status = jsonField(line, "status");
+		}
+		else
+		{
+			std::vector<std::string> fields;
+			std::stringstream ss(line);
+			std::string field;
+			while (std::getline(ss, field, ','))
+			{
+				fields.push_back(field);
+			}
+			if (fields.size() != 8 || fields[0] == "op")
+			{
+				continue;
+			}
+			m.op = fields[0];
+			m.radix = std::atoi(fields[1].c_str());
+			m.words = std::strtoull(fields[2].c_str(), nullptr, 10);
+			m.nsPerOp = std::atof(fields[4].c_str());
+			status = fields[7];
+		}
+		if (status == "ok")
+		{
+			baseline[key(m.op, m.radix, m.words)] = m;
+		}
+	}
+	return baseline;
+}
+
+size_t compare(const std::vector<Measurement> & results, const Baseline & baseline, double threshold)
+{
+	size_t regressions = 0;
+	for (const Measurement & m : results)
+	{
+		auto it = baseline.find(key(m.op, m.radix, m.words));
+		if (m.skipped || it == baseline.end() || it->second.nsPerOp <= 0)
+		{
+			continue;
+		}
+		double change = (m.nsPerOp / it->second.nsPerOp - 1) * 100;
+		if (change > threshold)
+		{
+			fprintf(stderr, "REGRESSION %s radix %d at %zu words: %.1f -> %.1f ns/op (%+.1f%%)\n",
+				m.op.c_str(), m.radix, m.words, it->second.nsPerOp, m.nsPerOp, change);
+			regressions++;
+		}
+	}
+	return regressions;
+}
+
+void usage()
+{
+	std::cout << "Usage: biginteger_benchmark [options]" << std::endl
+		<< "  --min-words N      smallest operand size in 32 bit words (default 1)" << std::endl
+		<< "  --max-words N      largest operand size, sizes double up to it (default 1048576)" << std::endl
+		<< "  --min-time S       seconds to repeat each measurement for (default 0.2)" << std::endl
+		<< "  --max-op-time S    skip sizes predicted to take longer per operation (default 2)" << std::endl
+		<< "  --ops a,b,...      only run the named operations" << std::endl
+		<< "  --format csv|json  output format (default csv)" << std::endl
+		<< "  --output FILE      write results to FILE instead of standard output" << std::endl
+		<< "  --baseline FILE    compare against an earlier csv or json result" << std::endl
+		<< "  --threshold P      percent slowdown reported as a regression (default 10)" << std::endl;
+}
+
+// the whole of value as a count, failing on anything strtoull would skip
+bool parseCount(const std::string & value, size_t & count)
+{
+	char * end = nullptr;
+	if (value.empty() || value[0] < '0' || value[0] > '9')
+	{
+		return false;
+	}
+	count = std::strtoull(value.c_str(), &end, 10);
+	return *end == '\0';
+}
+
+bool parseNumber(const std::string & value, double & number)
+{
+	char * end = nullptr;
+	number = std::strtod(value.c_str(), &end);
+	return !value.empty() && *end == '\0' && number >= 0;
+}
+
+bool parseOptions(int argc, char * argv[], Options & options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help" || i + 1 >= argc)
+		{
+			return false;
+		}
+		std::string value = argv[++i];
+		if (arg == "--min-words")
+		{
+			if (!parseCount(value, options.minWords))
+			{
+				return false;
+			}
+			options.minWords = std::max<size_t>(1, options.minWords);
+		}
+		else if (arg == "--max-words")
+		{
+			if (!parseCount(value, options.maxWords))
+			{
+				return false;
+			}
+		}
+		else if (arg == "--min-time")
+		{
+			if (!parseNumber(value, options.minTime) || options.minTime == 0)
+			{
+				return false;
+			}
+		}
+		else if (arg == "--max-op-time")
+		{
+			if (!parseNumber(value, options.maxOpTime))
+			{
+				return false;
+			}
+		}
+		else if (arg == "--ops")
+		{
+			std::vector<Benchmark> known = benchmarks();
+			std::stringstream ss(value);
+			std::string op;
+			while (std::getline(ss, op, ','))
+			{
+				// a misspelt name would otherwise run nothing and report success
+				if (std::none_of(known.begin(), known.end(), [&](const Benchmark & benchmark) { return benchmark.name == op; }))
+				{
+					return false;
+				}
+				options.ops.push_back(op);
+			}
+		}
+		else if (arg == "--format" && (value == "csv" || value == "json"))
+		{
+			options.format = value;
+		}
+		else if (arg == "--output")
+		{
+			options.output = value;
+		}
+		else if (arg == "--baseline")
+		{
+			options.baseline = value;
+		}
+		else if (arg == "--threshold")
+		{
+			if (!parseNumber(value, options.threshold))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char * argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+	try
+	{
+		// read the baseline first so a bad path fails before the long run
+		Baseline baseline;
+		if (!options.baseline.empty())
+		{
+			baseline = readBaseline(options.baseline);
+		}
+		// results are only comparable between runs on the same kernels
+		std::cerr << "limb kernels: " << LimbKernels::describe() << std::endl;
+		std::vector<Measurement> results = run(options);
+		std::ofstream file;
+		if (!options.output.empty())
+		{
+			file.open(options.output);
+			if (!file)
+			{
+				throw "Cannot open output";
+			}
+		}
+		std::ostream & out = options.output.empty() ? std::cout : file;
+		if (options.format == "json")
+		{
+			writeJson(out, results);
+		}
+		else
+		{
+			writeCsv(out, results);
+		}
+		if (!options.baseline.empty() && compare(results, baseline, options.threshold) > 0)
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const char * message)
+	{
+		std::cerr << message << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/*
+* Paul Fulham
+*
+* g++ -std=c++14 -O2 -pthread -o biginteger_benchmark biginteger.h biginteger_tuning.h magnitude.h biginteger.cpp limbkernels.h limbkernels.cpp threadpool.h threadpool.cpp biginteger_benchmark.h biginteger_benchmark.cpp
+*
+* cl -O2 -Fe:biginteger_benchmark.exe -EHsc biginteger.cpp limbkernels.cpp threadpool.cpp biginteger_benchmark.cpp
+*
+* Non-interactive throughput benchmark, run with --help for the options
+*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+
+#include "biginteger.h"
+
+struct Operands
+{
+	BigInteger a;
+
+	BigInteger b;
+
+	std::string text;
+};
+
+struct Benchmark
+{
+	std::string name;
+
+	int radix;
+
+	std::function<Operands(size_t)> setup;
+
+	std::function<size_t(const Operands &)> run;
+};
+
+struct Measurement
+{
+	std::string op;
+
+	int radix;
+
+	size_t words;
+
+	uint64_t iterations;
+
+	double nsPerOp;
+
+	double wordsPerSecond;
+
+	double allocationsPerOp;
+
+	bool skipped;
+};
+
+struct Options
+{
+	size_t minWords = 1;
+
+	size_t maxWords = 1 << 20;
+
+	double minTime = 0.2;
+
+	double maxOpTime = 2.0;
+
+	std::string format = "csv";
+
+	std::string output;
+
+	std::string baseline;
+
+	double threshold = 10.0;
+
+	std::vector<std::string> ops;
+};
+
+typedef std::map<std::string, Measurement> Baseline;
@@ -7,6 +7,7 @@
 #include <stdio.h>
 
 #include "biginteger.h"
+#include "bigintegerview.h"
 #include "biginteger_tester.h"
 
 template <typename T>
@@ -19,6 +20,19 @@ std::function<bool(BigInteger &, BigInteger &)> printing(T(BigInteger::*operatio
 	};
 }
 
+// A and B multiplied through views, then again raised past the Karatsuba
+// threshold, where a top word of one leaves the product a word short of both
+// lengths together
+bool viewProduct(BigInteger & a, BigInteger & b)
+{
+	BigInteger high = BigInteger(1) << (32 * TUNED_KARATSUBA_THRESHOLD);
+	BigInteger x = high + a.abs(), y = high + b.abs();
+	BigInteger product = BigIntegerView(a) * BigIntegerView(b);
+	bool match = product == a * b && BigIntegerView(x) * BigIntegerView(y) == x * y;
+	std::cout << a << " * " << b << " = " << product << (match ? "" : " (views disagree with BigInteger)") << std::endl;
+	return false;
+}
+
 void clear(std::istream & in)
 {
 	in.clear();
@@ -54,6 +68,10 @@ int main()
 		{ "Multiplication", printing(&BigInteger::operator*, "*") },
 		{ "Division", printing(&BigInteger::operator/,"/") },
 		{ "Modulus", printing(&BigInteger::operator%, "%") },
+		{ "Bitwise and", printing(&BigInteger::operator&, "&") },
+		{ "Bitwise or", printing(&BigInteger::operator|, "|") },
+		{ "Bitwise xor", printing(&BigInteger::operator^, "^") },
+		{ "View multiplication", viewProduct },
 		{ "Exit", [](auto a, auto b) { return true; } }
 	};
 	int status = EXIT_FAILURE;
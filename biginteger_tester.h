@@ -1,9 +1,9 @@
 /*
 * Paul Fulham
 *
-* g++ -std=c++14 -o biginteger biginteger.h biginteger.cpp biginteger_tester.h biginteger_tester.cpp
+* g++ -std=c++14 -pthread -o biginteger biginteger.h biginteger_tuning.h magnitude.h biginteger.cpp limbkernels.h limbkernels.cpp threadpool.h threadpool.cpp bigintegerview.h bigintegerview.cpp biginteger_tester.h biginteger_tester.cpp
 *
-* cl -Fe:biginteger.exe -EHsc biginteger.cpp biginteger_tester.cpp
+* cl -Fe:biginteger.exe -EHsc biginteger.cpp limbkernels.cpp threadpool.cpp bigintegerview.cpp biginteger_tester.cpp
 *
 * BigInteger is my C++ partial translation of Java's BigInteger
 */
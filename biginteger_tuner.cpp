@@ -0,0 +1,343 @@
+/*
+* Paul Fulham
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include "biginteger.h"
+#include "biginteger_tuner.h"
+#include "limbkernels.h"
+#include "threadpool.h"
+
+// a crossover must hold for this many consecutive sizes, so one noisy
+// timing cannot settle it early
+static const int CONFIRMATIONS = 3;
+
+static std::mt19937 generator(0x7E57);
+
+BigIntegerTuner::BigIntegerTuner(double minTime) :
+	minTime(minTime)
+{
+}
+
+int BigIntegerTuner::schoenhageThreshold()
+{
+	std::vector<int> sizes;
+	for (int n = 4; n <= 1024; n += std::max(1, n / 8))
+	{
+		sizes.push_back(n);
+	}
+	return crossover(sizes, [this](int n)
+	{
+		BigInteger u = randomWords(n);
+		// a threshold just below n splits once at the top and converts both
+		// halves directly, which is the choice the threshold decides
+		double small = time([&] { return u.smallToString(10).size(); });
+		double split = time([&]
+		{
+			std::string sb;
+			BigInteger::toString(u, sb, 10, 0, n - 1);
+			return sb.size();
+		});
+		return split < small;
+	});
+}
+
+int BigIntegerTuner::knuthPow2Zeros()
+{
+	std::vector<int> zeros;
+	for (int z = 1; z <= 64; z++)
+	{
+		zeros.push_back(z);
+	}
+	return crossover(zeros, [this](int z)
+	{
+		// zeros make up a fixed share of long operands, so this measures the
+		// cost of the shifts against the rows they save
+		BigInteger b = randomWords(32) << (32 * z);
+		BigInteger a = randomWords(64) << (32 * z);
+		BigInteger q;
+		double plain = time([&] { return a.divideMagnitude(b, q).bitLength(); });
+		double shifted = time([&] { return a.divideShifted(b, q, 32 * z).bitLength(); });
+		return shifted < plain;
+	});
+}
+
+int BigIntegerTuner::knuthPow2Length(int zeros)
+{
+	std::vector<int> lengths;
+	for (int len = zeros + 2; len <= 4096; len += std::max(1, len / 8))
+	{
+		lengths.push_back(len);
+	}
+	return crossover(lengths, [this, zeros](int len)
+	{
+		// the divisor keeps one significant word beyond its zeros so both
+		// sides still run the multiword division
+		int divisorLen = std::max(zeros + 2, len / 2);
+		BigInteger a = randomWords(std::max(len, divisorLen + 1) - zeros) << (32 * zeros);
+		BigInteger b = randomWords(divisorLen - zeros) << (32 * zeros);
+		BigInteger q;
+		double plain = time([&] { return a.divideMagnitude(b, q).bitLength(); });
+		double shifted = time([&] { return a.divideShifted(b, q, 32 * zeros).bitLength(); });
+		return shifted < plain;
+	});
+}
+
+int BigIntegerTuner::wideMultiplyThreshold()
+{
+	LimbKernels::Table portable = LimbKernels::portable();
+	const LimbKernels::Table & selected = LimbKernels::table();
+	if (selected.multiply == portable.multiply)
+	{
+		// without a wide kernel there is nothing to choose between
+		return INT32_MAX;
+	}
+	std::vector<int> sizes;
+	for (int n = 2; n <= 64; n++)
+	{
+		sizes.push_back(n);
+	}
+	return crossover(sizes, [&](int n)
+	{
+		BigInteger x = randomWords(n), y = randomWords(n);
+		std::vector<int32_t> z(2 * n);
+		double scalar = time([&]
+		{
+			portable.multiply(x.mag.data(), n, y.mag.data(), n, z.data());
+			return (size_t)z[0];
+		});
+		double wide = time([&]
+		{
+			selected.multiply(x.mag.data(), n, y.mag.data(), n, z.data());
+			return (size_t)z[0];
+		});
+		return wide < scalar;
+	});
+}
+
+int BigIntegerTuner::karatsubaThreshold()
+{
+	std::vector<int> sizes;
+	for (int n = 16; n <= 2048; n += std::max(1, n / 8))
+	{
+		sizes.push_back(n);
+	}
+	return crossover(sizes, [this](int n)
+	{
+		BigInteger x = randomWords(n), y = randomWords(n);
+		// a threshold just below n splits once at the top and multiplies the
+		// halves as the current build would, which is the choice it decides
+		double direct = time([&] { return BigInteger::multiplyToLen(x.mag, n, y.mag, n).size(); });
+		double split = time([&] { return BigInteger::multiplyKaratsuba(x, y).bitLength(); });
+		return split < direct;
+	});
+}
+
+int BigIntegerTuner::burnikelZieglerThreshold()
+{
+	std::vector<int> sizes;
+	for (int n = 16; n <= 2048; n += std::max(2, n / 8 & ~1))
+	{
+		sizes.push_back(n);
+	}
+	return crossover(sizes, [this](int n)
+	{
+		// a normalized divisor and a dividend below it shifted up n words,
+		// the shape divide2n1n is given
+		BigInteger b = randomWords(n);
+		BigInteger a = randomWords(2 * n - 1);
+		size_t half = n / 2;
+		BigInteger b1 = b.getUpper(half), b2 = b.getLower(half);
+		BigInteger q;
+		double schoolbook = time([&] { return a.divideSchoolbook(b, q).bitLength(); });
+		double split = time([&]
+		{
+			// the two halves of the quotient, as divide2n1n finds them
+			BigInteger q1, q2, r;
+			BigInteger::divide3n2n(a.getUpper(n), a.getBlock(1, half), b, b1, b2, half, q1, r);
+			BigInteger::divide3n2n(r, a.getLower(half), b, b1, b2, half, q2, r);
+			return r.bitLength();
+		});
+		return split < schoolbook;
+	});
+}
+
+int BigIntegerTuner::parallelMultiplyThreshold()
+{
+	if (std::thread::hardware_concurrency() < 2)
+	{
+		// one hardware thread gains nothing from a pool
+		return INT32_MAX;
+	}
+	ThreadPool pool;
+	std::vector<int> sizes;
+	for (int words = 256; words <= 65536; words += words / 4)
+	{
+		sizes.push_back(words);
+	}
+	return crossover(sizes, [&](int words)
+	{
+		// the three sub-products of one Karatsuba split of a product this long
+		BigInteger x = randomWords(words / 4), y = randomWords(words / 4), z = randomWords(words / 4 + 1);
+		BigInteger p[3];
+		std::vector<std::function<void()>> tasks =
+		{
+			[&] { p[0] = x * y; },
+			[&] { p[1] = y * z; },
+			[&] { p[2] = z * x; }
+		};
+		double serial = time([&]
+		{
+			for (auto & task : tasks)
+			{
+				task();
+			}
+			return p[0].mag.size();
+		});
+		double parallel = time([&]
+		{
+			pool.invoke(tasks);
+			return p[0].mag.size();
+		});
+		return parallel < serial;
+	});
+}
+
+double BigIntegerTuner::time(const std::function<size_t()> & operation) const
+{
+	typedef std::chrono::steady_clock clock;
+	volatile size_t sink = 0;
+	uint64_t iterations = 1;
+	double best = 0;
+	// the fastest of a few runs is the least disturbed by the rest of the
+	// machine, which matters more here than the mean
+	for (int run = 0; run < 3; run++)
+	{
+		while (true)
+		{
+			clock::time_point start = clock::now();
+			for (uint64_t i = 0; i < iterations; i++)
+			{
+				sink = sink + operation();
+			}
+			double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			if (elapsed >= this->minTime)
+			{
+				double perOp = elapsed / iterations;
+				best = run == 0 ? perOp : std::min(best, perOp);
+				break;
+			}
+			iterations *= 2;
+		}
+	}
+	return best;
+}
+
+int BigIntegerTuner::crossover(const std::vector<int> & sizes, const std::function<bool(int)> & secondWins) const
+{
+	int streak = 0;
+	for (size_t i = 0; i < sizes.size(); i++)
+	{
+		if (!secondWins(sizes[i]))
+		{
+			streak = 0;
+		}
+		else if (++streak == CONFIRMATIONS)
+		{
+			return sizes[i + 1 - CONFIRMATIONS];
+		}
+	}
+	// the second algorithm never won, so the threshold is never reached
+	return INT32_MAX;
+}
+
+BigInteger BigIntegerTuner::randomWords(size_t words)
+{
+	BigInteger result;
+	for (size_t i = 0; i < words; i++)
+	{
+		result = (result << 32) + (int64_t)(generator() | (i == 0 ? 0x80000000 : 0));
+	}
+	return result;
+}
+
+int main(int argc, char * argv[])
+{
+	std::string output = "biginteger_tuning.h";
+	double minTime = 0.02;
+	bool valid = argc % 2 == 1;
+	for (int i = 1; valid && i + 1 < argc; i += 2)
+	{
+		std::string arg = argv[i];
+		if (arg == "--output")
+		{
+			output = argv[i + 1];
+		}
+		else if (arg == "--min-time")
+		{
+			minTime = std::atof(argv[i + 1]);
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+	if (!valid || minTime <= 0)
+	{
+		std::cerr << "Usage: biginteger_tuner [--output FILE] [--min-time SECONDS]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	BigIntegerTuner tuner(minTime);
+	int schoenhage = tuner.schoenhageThreshold();
+	std::cerr << "Schoenhage toString from " << schoenhage << " words" << std::endl;
+	int zeros = tuner.knuthPow2Zeros();
+	int length = zeros == INT32_MAX ? INT32_MAX : tuner.knuthPow2Length(zeros);
+	// the library compares zeros * 32 against a bit count, which must not overflow
+	zeros = std::min(zeros, INT32_MAX / 32);
+	std::cerr << "Knuth power of two shift from " << zeros << " zero words and " << length << " words" << std::endl;
+	int wide = tuner.wideMultiplyThreshold();
+	std::cerr << "wide multiply kernel from " << wide << " words" << std::endl;
+	int karatsuba = tuner.karatsubaThreshold();
+	std::cerr << "Karatsuba multiply from " << karatsuba << " words" << std::endl;
+	int burnikelZiegler = tuner.burnikelZieglerThreshold();
+	std::cerr << "Burnikel-Ziegler division from " << burnikelZiegler << " words" << std::endl;
+	int parallel = tuner.parallelMultiplyThreshold();
+	std::cerr << "parallel multiply from " << parallel << " product words" << std::endl;
+	std::ofstream out(output);
+	out << "/*" << std::endl
+		<< "* Crossover sizes in 32 bit words, written by biginteger_tuner from timings" << std::endl
+		<< "* on the build machine. Rerun the tuner rather than editing by hand. Any of" << std::endl
+		<< "* them can also be overridden with -D on the compiler command line" << std::endl
+		<< "*/" << std::endl
+		<< std::endl
+		<< "#pragma once" << std::endl;
+	const std::pair<const char *, int> values[] =
+	{
+		{ "TUNED_SCHOENHAGE_BASE_CONVERSION_THRESHOLD", schoenhage },
+		{ "TUNED_KNUTH_POW2_THRESH_LEN", length },
+		{ "TUNED_KNUTH_POW2_THRESH_ZEROS", zeros },
+		{ "TUNED_KARATSUBA_THRESHOLD", karatsuba },
+		{ "TUNED_BURNIKEL_ZIEGLER_THRESHOLD", burnikelZiegler },
+		{ "TUNED_PARALLEL_MULTIPLY_THRESHOLD", parallel },
+		{ "TUNED_WIDE_MULTIPLY_THRESHOLD", wide }
+	};
+	for (auto & value : values)
+	{
+		out << std::endl
+			<< "#ifndef " << value.first << std::endl
+			<< "#define " << value.first << " " << value.second << std::endl
+			<< "#endif" << std::endl;
+	}
+	if (!out)
+	{
+		std::cerr << "Cannot write " << output << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
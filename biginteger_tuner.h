@@ -0,0 +1,57 @@
+/*
+* Paul Fulham
+*
+* g++ -std=c++14 -O2 -pthread -o biginteger_tuner biginteger.h biginteger_tuning.h magnitude.h biginteger.cpp limbkernels.h limbkernels.cpp threadpool.h threadpool.cpp biginteger_tuner.h biginteger_tuner.cpp
+*
+* cl -O2 -Fe:biginteger_tuner.exe -EHsc biginteger.cpp limbkernels.cpp threadpool.cpp biginteger_tuner.cpp
+*
+* Times the competing algorithms behind each threshold and writes the
+* crossovers to biginteger_tuning.h, after which the library is rebuilt
+*/
+
+#pragma once
+
+#include <functional>
+
+#include "biginteger.h"
+
+class BigIntegerTuner
+{
+public:
+	BigIntegerTuner(double minTime);
+
+	// the smallest size in words at which one Schoenhage split beats
+	// converting the whole value with repeated division
+	int schoenhageThreshold();
+
+	// the fewest common trailing zero words worth shifting out of a division
+	int knuthPow2Zeros();
+
+	// the shortest dividend at which shifting out the given zero words pays
+	int knuthPow2Length(int zeros);
+
+	// the shortest operands the 64 bit limb multiply kernel beats the
+	// scalar one at, which decides between them on this processor
+	int wideMultiplyThreshold();
+
+	// the shortest operands at which one Karatsuba split beats multiplying
+	// them directly
+	int karatsubaThreshold();
+
+	// the shortest divisor at which one Burnikel-Ziegler split beats
+	// schoolbook division of a dividend twice its length
+	int burnikelZieglerThreshold();
+
+	// the shortest product whose sub-products are worth handing to a pool
+	// rather than computing one after another
+	int parallelMultiplyThreshold();
+
+private:
+	double minTime;
+
+	double time(const std::function<size_t()> & operation) const;
+
+	int crossover(const std::vector<int> & sizes, const std::function<bool(int)> & secondWins) const;
+
+	static BigInteger randomWords(size_t words);
+};
@@ -0,0 +1,45 @@
+/*
+* Crossover sizes in 32 bit words, written by biginteger_tuner from timings
+* on the build machine. Rerun the tuner rather than editing by hand; until
+* then these are the library's defaults. Any of them can also be
+* overridden with -D on the compiler command line
+*
+* The defaults are not one machine's timings. The string conversion ones
+* are Java's. The multiply and division ones fall between the crossovers
+* of the scalar kernels, about 72 and 54 words, and those of the 64 bit
+* BMI2 kernels, about 230 to 320 and 80 to 140 words, since the same
+* build may run on either. Near a crossover both algorithms cost about
+* the same, so neither kind of machine loses much to the compromise. The
+* wide kernel one is as measured with BMI2, from 5 to 8 words. The parallel
+* one is an estimate, as a tuner run on one core cannot measure it
+*/
+
+#pragma once
+
+#ifndef TUNED_SCHOENHAGE_BASE_CONVERSION_THRESHOLD
+#define TUNED_SCHOENHAGE_BASE_CONVERSION_THRESHOLD 20
+#endif
+
+#ifndef TUNED_KNUTH_POW2_THRESH_LEN
+#define TUNED_KNUTH_POW2_THRESH_LEN 6
+#endif
+
+#ifndef TUNED_KNUTH_POW2_THRESH_ZEROS
+#define TUNED_KNUTH_POW2_THRESH_ZEROS 3
+#endif
+
+#ifndef TUNED_KARATSUBA_THRESHOLD
+#define TUNED_KARATSUBA_THRESHOLD 160
+#endif
+
+#ifndef TUNED_BURNIKEL_ZIEGLER_THRESHOLD
+#define TUNED_BURNIKEL_ZIEGLER_THRESHOLD 80
+#endif
+
+#ifndef TUNED_PARALLEL_MULTIPLY_THRESHOLD
+#define TUNED_PARALLEL_MULTIPLY_THRESHOLD 2048
+#endif
+
+#ifndef TUNED_WIDE_MULTIPLY_THRESHOLD
+#define TUNED_WIDE_MULTIPLY_THRESHOLD 8
+#endif
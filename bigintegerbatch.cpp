@@ -0,0 +1,279 @@
+/*
+* Paul Fulham
+*/
+
+#include <algorithm>
+
+#include "bigintegerbatch.h"
+
+// The column loops are written for the vectorizer, which GCC only runs with
+// a cost model that allows them from -O3, so they ask for it themselves
+#if defined(__GNUC__) && !defined(__clang__)
+#define BATCH_KERNEL __attribute__((optimize("tree-vectorize", "vect-cost-model=dynamic")))
+#else
+#define BATCH_KERNEL
+#endif
+
+// r = a + (b ^ invert) + carry down one column, carrying into the next
+BATCH_KERNEL static void addColumn(uint32_t * __restrict r, const uint32_t * __restrict a, const uint32_t * __restrict b, uint32_t invert, uint32_t * __restrict carry, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		uint64_t t = (uint64_t)a[i] + (b[i] ^ invert) + carry[i];
+		r[i] = (uint32_t)t;
+		carry[i] = (uint32_t)(t >> 32);
+	}
+}
+
+// r = a * y + carry down one column, carrying into the next
+BATCH_KERNEL static void scaleColumn(uint32_t * __restrict r, const uint32_t * __restrict a, uint32_t y, uint32_t * __restrict carry, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		uint64_t t = (uint64_t)a[i] * y + carry[i];
+		r[i] = (uint32_t)t;
+		carry[i] = (uint32_t)(t >> 32);
+	}
+}
+
+// the last signed difference, carried from the columns above, unless it is
+// still zero
+BATCH_KERNEL static void compareColumn(int * __restrict r, const uint32_t * __restrict a, const uint32_t * __restrict b, uint32_t bias, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		uint32_t p = a[i] ^ bias, q = b[i] ^ bias;
+		int c = (int)(p > q) - (int)(p < q);
+		r[i] = r[i] != 0 ? r[i] : c;
+	}
+}
+
+BigIntegerBatch::BigIntegerBatch() :
+	count(0),
+	words(2)
+{
+}
+
+BigIntegerBatch::BigIntegerBatch(const std::vector<BigInteger> & values) :
+	count(values.size()),
+	words(2)
+{
+	size_t widest = 0;
+	for (const BigInteger & value : values)
+	{
+		// the sign takes a bit of its own
+		widest = std::max(widest, value.bitLength() / 32 + 1);
+	}
+	this->words = widthClass(widest);
+	this->limbs.resize(this->words * this->count);
+	for (size_t i = 0; i < this->count; i++)
+	{
+		for (size_t k = 0; k < this->words; k++)
+		{
+			this->limbs[k * this->count + i] = (uint32_t)values[i].getInt(k);
+		}
+	}
+}
+
+size_t BigIntegerBatch::size() const
+{
+	return this->count;
+}
+
+size_t BigIntegerBatch::width() const
+{
+	return this->words;
+}
+
+BigInteger BigIntegerBatch::operator[](size_t index) const
+{
+	if (index >= this->count)
+	{
+		throw "Batch index out of range";
+	}
+	std::vector<int32_t> value(this->words);
+	for (size_t k = 0; k < this->words; k++)
+	{
+		value[this->words - 1 - k] = (int32_t)this->limbs[k * this->count + index];
+	}
+	return BigInteger(value);
+}
+
+std::vector<BigInteger> BigIntegerBatch::toBigIntegers() const
+{
+	std::vector<BigInteger> values;
+	values.reserve(this->count);
+	for (size_t i = 0; i < this->count; i++)
+	{
+		values.push_back((*this)[i]);
+	}
+	return values;
+}
+
+BigIntegerBatch BigIntegerBatch::operator+(const BigIntegerBatch & rhs) const
+{
+	checkSize(rhs);
+	BigIntegerBatch result;
+	for (size_t width = std::max(this->words, rhs.words); !result.sum(*this, rhs, false, width); width *= 2);
+	return result;
+}
+
+BigIntegerBatch BigIntegerBatch::operator-(const BigIntegerBatch & rhs) const
+{
+	checkSize(rhs);
+	BigIntegerBatch result;
+	for (size_t width = std::max(this->words, rhs.words); !result.sum(*this, rhs, true, width); width *= 2);
+	return result;
+}
+
+BigIntegerBatch BigIntegerBatch::operator*(int32_t rhs) const
+{
+	uint32_t y = rhs < 0 ? 0 - (uint32_t)rhs : (uint32_t)rhs;
+	BigIntegerBatch result;
+	for (size_t width = this->words; !result.scale(*this, y, width); width *= 2);
+	return rhs < 0 ? -result : result;
+}
+
+BigIntegerBatch BigIntegerBatch::operator-() const
+{
+	BigIntegerBatch result;
+	for (size_t width = this->words; !result.negate(*this, width); width *= 2);
+	return result;
+}
+
+BigIntegerBatch & BigIntegerBatch::operator+=(const BigIntegerBatch & rhs)
+{
+	return *this = *this + rhs;
+}
+
+BigIntegerBatch & BigIntegerBatch::operator-=(const BigIntegerBatch & rhs)
+{
+	return *this = *this - rhs;
+}
+
+BigIntegerBatch & BigIntegerBatch::operator*=(int32_t rhs)
+{
+	return *this = *this * rhs;
+}
+
+std::vector<int> BigIntegerBatch::compare(const BigIntegerBatch & rhs) const
+{
+	checkSize(rhs);
+	const size_t n = this->count, width = std::max(this->words, rhs.words);
+	std::vector<uint32_t> xs = signs(), ys = rhs.signs();
+	std::vector<int> result(n, 0);
+	// the top words decide first, and only they compare as signed
+	uint32_t bias = 0x80000000u;
+	for (size_t k = width; k-- > 0; bias = 0)
+	{
+		compareColumn(result.data(), column(k, xs), rhs.column(k, ys), bias, n);
+	}
+	return result;
+}
+
+const uint32_t * BigIntegerBatch::column(size_t k, const std::vector<uint32_t> & signs) const
+{
+	return k < this->words ? this->limbs.data() + k * this->count : signs.data();
+}
+
+std::vector<uint32_t> BigIntegerBatch::signs() const
+{
+	std::vector<uint32_t> result(this->count);
+	const uint32_t * top = this->limbs.data() + (this->words - 1) * this->count;
+	for (size_t i = 0; i < this->count; i++)
+	{
+		result[i] = (uint32_t)((int32_t)top[i] >> 31);
+	}
+	return result;
+}
+
+bool BigIntegerBatch::sum(const BigIntegerBatch & x, const BigIntegerBatch & y, bool subtract, size_t width)
+{
+	const size_t n = x.count;
+	std::vector<uint32_t> xs = x.signs(), ys = y.signs();
+	this->count = n;
+	this->words = width;
+	this->limbs.resize(width * n);
+	// x - y is x + ~y + 1
+	const uint32_t invert = subtract ? 0xFFFFFFFFu : 0;
+	std::vector<uint32_t> carry(n, subtract ? 1 : 0);
+	for (size_t k = 0; k < width; k++)
+	{
+		addColumn(this->limbs.data() + k * n, x.column(k, xs), y.column(k, ys), invert, carry.data(), n);
+	}
+	// a sum overflows when both terms share a sign the result lacks
+	const uint32_t * a = x.column(width - 1, xs), * b = y.column(width - 1, ys);
+	const uint32_t * r = this->limbs.data() + (width - 1) * n;
+	uint32_t overflow = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		overflow |= ~(a[i] ^ b[i] ^ invert) & (a[i] ^ r[i]);
+	}
+	return (overflow >> 31) == 0;
+}
+
+bool BigIntegerBatch::scale(const BigIntegerBatch & x, uint32_t y, size_t width)
+{
+	const size_t n = x.count;
+	std::vector<uint32_t> xs = x.signs();
+	this->count = n;
+	this->words = width;
+	this->limbs.resize(width * n);
+	std::vector<uint32_t> carry(n, 0);
+	for (size_t k = 0; k < width; k++)
+	{
+		scaleColumn(this->limbs.data() + k * n, x.column(k, xs), y, carry.data(), n);
+	}
+	// the words of a negative x read as unsigned are x + 2^(32 width), so
+	// the true word above the product is the carry less y, and the product
+	// fits when that word only extends the sign
+	const uint32_t * r = this->limbs.data() + (width - 1) * n;
+	uint32_t overflow = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		overflow |= (carry[i] - (xs[i] & y)) ^ (uint32_t)((int32_t)r[i] >> 31);
+	}
+	return overflow == 0;
+}
+
+bool BigIntegerBatch::negate(const BigIntegerBatch & x, size_t width)
+{
+	const size_t n = x.count;
+	std::vector<uint32_t> xs = x.signs();
+	this->count = n;
+	this->words = width;
+	this->limbs.resize(width * n);
+	// -x is 0 + ~x + 1
+	std::vector<uint32_t> zero(n, 0), carry(n, 1);
+	for (size_t k = 0; k < width; k++)
+	{
+		addColumn(this->limbs.data() + k * n, zero.data(), x.column(k, xs), 0xFFFFFFFFu, carry.data(), n);
+	}
+	// only the most negative value stays negative
+	const uint32_t * a = x.column(width - 1, xs);
+	const uint32_t * r = this->limbs.data() + (width - 1) * n;
+	uint32_t overflow = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		overflow |= a[i] & r[i];
+	}
+	return (overflow >> 31) == 0;
+}
+
+void BigIntegerBatch::checkSize(const BigIntegerBatch & rhs) const
+{
+	if (this->count != rhs.count)
+	{
+		throw "Batch sizes differ";
+	}
+}
+
+size_t BigIntegerBatch::widthClass(size_t words)
+{
+	size_t width = 2;
+	while (width < words)
+	{
+		width *= 2;
+	}
+	return width;
+}
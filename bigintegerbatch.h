@@ -0,0 +1,72 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include "biginteger.h"
+
+// Many small BigIntegers held side by side for elementwise arithmetic. Every
+// value is stored as two's complement in the same width class of 2, 4, 8 or
+// more words, and word k of every value sits in one column, so each step of
+// an operation runs the same instructions down contiguous memory the
+// compiler can vectorize. An operation whose results would not fit moves the
+// whole batch up to the next width class
+class BigIntegerBatch
+{
+public:
+	BigIntegerBatch();
+
+	BigIntegerBatch(const std::vector<BigInteger> & values);
+
+	size_t size() const;
+
+	// the words each value is stored in
+	size_t width() const;
+
+	BigInteger operator[](size_t index) const;
+
+	std::vector<BigInteger> toBigIntegers() const;
+
+	BigIntegerBatch operator+(const BigIntegerBatch & rhs) const;
+
+	BigIntegerBatch operator-(const BigIntegerBatch & rhs) const;
+
+	BigIntegerBatch operator*(int32_t rhs) const;
+
+	BigIntegerBatch operator-() const;
+
+	BigIntegerBatch & operator+=(const BigIntegerBatch & rhs);
+
+	BigIntegerBatch & operator-=(const BigIntegerBatch & rhs);
+
+	BigIntegerBatch & operator*=(int32_t rhs);
+
+	// the sign of lhs[i] - rhs[i] for every i
+	std::vector<int> compare(const BigIntegerBatch & rhs) const;
+
+private:
+	size_t count;
+
+	size_t words;
+
+	// word k of value i, least significant first, is limbs[k * count + i]
+	std::vector<uint32_t> limbs;
+
+	// column k, or the sign words when k is past the width
+	const uint32_t * column(size_t k, const std::vector<uint32_t> & signs) const;
+
+	std::vector<uint32_t> signs() const;
+
+	// each returns false, leaving this unfinished, if a result needs more
+	// than width words
+	bool sum(const BigIntegerBatch & x, const BigIntegerBatch & y, bool subtract, size_t width);
+
+	bool scale(const BigIntegerBatch & x, uint32_t y, size_t width);
+
+	bool negate(const BigIntegerBatch & x, size_t width);
+
+	void checkSize(const BigIntegerBatch & rhs) const;
+
+	static size_t widthClass(size_t words);
+};
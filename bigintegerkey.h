@@ -0,0 +1,62 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include "biginteger.h"
+
+// A BigInteger that never changes, holding its hash from the start, for
+// keys that are looked up many times. Hashing one costs nothing, and keys
+// whose hashes differ compare unequal without reading their words
+class BigIntegerKey
+{
+public:
+	BigIntegerKey(const BigInteger & value) :
+		key(value),
+		hash(value.hashCode())
+	{
+	}
+
+	const BigInteger & value() const
+	{
+		return this->key;
+	}
+
+	operator const BigInteger &() const
+	{
+		return this->key;
+	}
+
+	size_t hashCode() const
+	{
+		return this->hash;
+	}
+
+	friend bool operator==(const BigIntegerKey & lhs, const BigIntegerKey & rhs)
+	{
+		return lhs.hash == rhs.hash && lhs.key == rhs.key;
+	}
+
+	friend bool operator!=(const BigIntegerKey & lhs, const BigIntegerKey & rhs)
+	{
+		return !(lhs == rhs);
+	}
+
+private:
+	BigInteger key;
+
+	size_t hash;
+};
+
+namespace std
+{
+	template <>
+	struct hash<BigIntegerKey>
+	{
+		size_t operator()(const BigIntegerKey & key) const
+		{
+			return key.hashCode();
+		}
+	};
+}
@@ -0,0 +1,96 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include "bigintegerview.h"
+
+// The words of a literal, least significant first, as the compiler works
+// them out
+template <size_t N>
+struct LiteralWords
+{
+	int32_t words[N];
+
+	size_t length;
+};
+
+// Parses the digits of an integer literal while compiling. Decimal, 0x hex,
+// 0b binary and 0 octal literals are read, with ' separators, and anything
+// else, such as a floating literal, stops the compile at the throw. A digit
+// carries at most four bits, so eight of them fill no more than a word
+template <char... Digits>
+struct BigIntegerLiteral
+{
+	static constexpr size_t WORDS = sizeof...(Digits) / 8 + 1;
+
+	static constexpr LiteralWords<WORDS> parse()
+	{
+		const char digits[] = { Digits... };
+		size_t count = sizeof...(Digits), start = 0;
+		uint32_t radix = 10;
+		if (count > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X'))
+		{
+			radix = 16;
+			start = 2;
+		}
+		else if (count > 2 && digits[0] == '0' && (digits[1] == 'b' || digits[1] == 'B'))
+		{
+			radix = 2;
+			start = 2;
+		}
+		else if (count > 1 && digits[0] == '0')
+		{
+			radix = 8;
+			start = 1;
+		}
+		LiteralWords<WORDS> result{};
+		for (size_t i = start; i < count; i++)
+		{
+			char c = digits[i];
+			if (c == '\'')
+			{
+				continue;
+			}
+			uint32_t digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'z' ? c - 'a' + 10 : c >= 'A' && c <= 'Z' ? c - 'A' + 10 : radix;
+			if (digit >= radix)
+			{
+				throw "Malformed number";
+			}
+			uint64_t carry = digit;
+			for (size_t j = 0; j < result.length; j++)
+			{
+				uint64_t t = (uint64_t)(uint32_t)result.words[j] * radix + carry;
+				result.words[j] = (int32_t)t;
+				carry = t >> 32;
+			}
+			if (carry != 0)
+			{
+				result.words[result.length++] = (int32_t)carry;
+			}
+		}
+		return result;
+	}
+
+	static constexpr LiteralWords<WORDS> value = parse();
+
+	// the literal as a view over its words, which live as long as the program
+	static BigIntegerView view()
+	{
+		return BigIntegerView(1, value.words, value.length, BigIntegerView::LEAST_SIGNIFICANT_FIRST);
+	}
+};
+
+template <char... Digits>
+constexpr LiteralWords<BigIntegerLiteral<Digits...>::WORDS> BigIntegerLiteral<Digits...>::value;
+
+// 123456789012345678901234567890_big is a BigInteger without parsing a
+// string. Each literal makes its BigInteger from the compiled words the
+// first time it is reached, and after that every use shares its magnitude
+template <char... Digits>
+BigInteger operator"" _big()
+{
+	static const BigInteger value = BigIntegerLiteral<Digits...>::view().toBigInteger();
+	return value;
+}
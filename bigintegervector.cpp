@@ -0,0 +1,247 @@
+/*
+* Paul Fulham
+*/
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_set>
+
+#include "bigintegervector.h"
+
+BigIntegerVector::BigIntegerVector() :
+	offsets(1, 0)
+{
+}
+
+BigIntegerVector::BigIntegerVector(const std::vector<BigInteger> & values) :
+	offsets(1, 0)
+{
+	size_t total = 0;
+	for (const BigInteger & value : values)
+	{
+		total += value.mag.size();
+	}
+	reserve(values.size(), total);
+	for (const BigInteger & value : values)
+	{
+		push_back(value);
+	}
+}
+
+size_t BigIntegerVector::size() const
+{
+	return this->offsets.size() - 1;
+}
+
+bool BigIntegerVector::empty() const
+{
+	return size() == 0;
+}
+
+size_t BigIntegerVector::words() const
+{
+	return this->limbs.size();
+}
+
+void BigIntegerVector::reserve(size_t values, size_t words)
+{
+	this->limbs.reserve(words);
+	this->offsets.reserve(values + 1);
+	this->negative.reserve((values + 63) / 64);
+}
+
+void BigIntegerVector::clear()
+{
+	this->limbs.clear();
+	this->offsets.assign(1, 0);
+	this->negative.clear();
+}
+
+void BigIntegerVector::push_back(const BigIntegerView & value)
+{
+	size_t start = this->limbs.size(), len = value.length();
+	if (this->limbs.capacity() < start + len)
+	{
+		// the value may be a view into this pool, so it is copied across
+		// before the old words are let go
+		std::vector<int32_t> grown;
+		grown.reserve(std::max(2 * this->limbs.capacity(), start + len));
+		grown.resize(start + len);
+		std::copy(this->limbs.begin(), this->limbs.end(), grown.begin());
+		value.write(grown.data() + start, len);
+		this->limbs.swap(grown);
+	}
+	else
+	{
+		this->limbs.resize(start + len);
+		value.write(this->limbs.data() + start, len);
+	}
+	size_t index = size();
+	if (index % 64 == 0)
+	{
+		this->negative.push_back(0);
+	}
+	if (value.signum() < 0)
+	{
+		this->negative[index / 64] |= (uint64_t)1 << (index % 64);
+	}
+	this->offsets.push_back(start + len);
+}
+
+BigIntegerView BigIntegerVector::operator[](size_t index) const
+{
+	if (index >= size())
+	{
+		throw "BigIntegerVector index out of range";
+	}
+	return BigIntegerView(signum(index), this->limbs.data() + this->offsets[index], this->offsets[index + 1] - this->offsets[index]);
+}
+
+std::vector<BigInteger> BigIntegerVector::toBigIntegers() const
+{
+	std::vector<BigInteger> values;
+	values.reserve(size());
+	for (size_t i = 0; i < size(); i++)
+	{
+		values.push_back((*this)[i].toBigInteger());
+	}
+	return values;
+}
+
+void BigIntegerVector::sort()
+{
+	std::vector<size_t> indices(size());
+	std::iota(indices.begin(), indices.end(), 0);
+	// only the indices move while sorting, the words are moved once after
+	std::sort(indices.begin(), indices.end(), [this](size_t i, size_t j)
+	{
+		return compare(i, j) < 0;
+	});
+	select(indices);
+}
+
+void BigIntegerVector::deduplicate()
+{
+	auto hash = [this](size_t i)
+	{
+		return this->hash(i);
+	};
+	auto equal = [this](size_t i, size_t j)
+	{
+		return compare(i, j) == 0;
+	};
+	std::unordered_set<size_t, decltype(hash), decltype(equal)> seen(size(), hash, equal);
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < size(); i++)
+	{
+		if (seen.insert(i).second)
+		{
+			indices.push_back(i);
+		}
+	}
+	if (indices.size() != size())
+	{
+		select(indices);
+	}
+}
+
+BigInteger BigIntegerVector::sum() const
+{
+	size_t runs = BigInteger::runCount(size());
+	std::vector<BigInteger::Columns> positive(runs), negative(runs);
+	BigInteger::forEachRun(runs, size(), this->limbs.size(), [&](size_t run, size_t from, size_t to)
+	{
+		for (size_t i = from; i < to; i++)
+		{
+			size_t start = this->offsets[i];
+			int sign = signum(i);
+			if (sign != 0)
+			{
+				(sign > 0 ? positive[run] : negative[run]).add(this->limbs.data() + start, this->offsets[i + 1] - start);
+			}
+		}
+	});
+	return BigInteger::resolve(positive, negative);
+}
+
+BigIntegerView BigIntegerVector::min() const
+{
+	return (*this)[extreme(1)];
+}
+
+BigIntegerView BigIntegerVector::max() const
+{
+	return (*this)[extreme(-1)];
+}
+
+int BigIntegerVector::signum(size_t index) const
+{
+	if (this->offsets[index] == this->offsets[index + 1])
+	{
+		return 0;
+	}
+	return (this->negative[index / 64] >> (index % 64) & 1) != 0 ? -1 : 1;
+}
+
+int BigIntegerVector::compare(size_t i, size_t j) const
+{
+	int si = signum(i), sj = signum(j);
+	if (si != sj)
+	{
+		return si < sj ? -1 : 1;
+	}
+	size_t a = this->offsets[i], b = this->offsets[j];
+	return si * BigInteger::compareWords(this->limbs.data() + a, this->offsets[i + 1] - a, this->limbs.data() + b, this->offsets[j + 1] - b);
+}
+
+size_t BigIntegerVector::hash(size_t index) const
+{
+	size_t start = this->offsets[index];
+	return (size_t)BigInteger::hashWords(signum(index), this->limbs.data() + start, this->offsets[index + 1] - start);
+}
+
+void BigIntegerVector::select(const std::vector<size_t> & indices)
+{
+	BigIntegerVector result;
+	size_t total = 0;
+	for (size_t i : indices)
+	{
+		total += this->offsets[i + 1] - this->offsets[i];
+	}
+	result.reserve(indices.size(), total);
+	for (size_t i : indices)
+	{
+		result.push_back((*this)[i]);
+	}
+	*this = std::move(result);
+}
+
+size_t BigIntegerVector::extreme(int sign) const
+{
+	if (empty())
+	{
+		throw "Empty BigIntegerVector";
+	}
+	size_t n = BigInteger::runCount(size());
+	std::vector<size_t> best(n);
+	BigInteger::forEachRun(n, size(), this->limbs.size(), [&](size_t run, size_t from, size_t to)
+	{
+		best[run] = from;
+		for (size_t i = from + 1; i < to; i++)
+		{
+			if (sign * compare(i, best[run]) < 0)
+			{
+				best[run] = i;
+			}
+		}
+	});
+	size_t result = best[0];
+	for (size_t run = 1; run < n; run++)
+	{
+		if (sign * compare(best[run], result) < 0)
+		{
+			result = best[run];
+		}
+	}
+	return result;
+}
@@ -0,0 +1,77 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include "bigintegerview.h"
+
+// A sequence of BigIntegers packed into one pool of words. The magnitudes
+// sit back to back in the pool, each a span of it given by an offset, and
+// the signs are kept one bit to a value, so a column of a million values is
+// three allocations rather than a million, and a scan over them runs through
+// contiguous memory. Values are read through views into the pool, which stay
+// valid until the vector next changes
+class BigIntegerVector
+{
+public:
+	BigIntegerVector();
+
+	BigIntegerVector(const std::vector<BigInteger> & values);
+
+	size_t size() const;
+
+	bool empty() const;
+
+	// the words held by all the values together
+	size_t words() const;
+
+	void reserve(size_t values, size_t words);
+
+	void clear();
+
+	void push_back(const BigIntegerView & value);
+
+	BigIntegerView operator[](size_t index) const;
+
+	std::vector<BigInteger> toBigIntegers() const;
+
+	// into ascending order
+	void sort();
+
+	// removes every value equal to one before it, keeping the order of
+	// those that remain
+	void deduplicate();
+
+	// The reductions split the values into one run per thread of the
+	// BigInteger pool when there is enough work to share. min and max throw
+	// for an empty vector
+
+	BigInteger sum() const;
+
+	BigIntegerView min() const;
+
+	BigIntegerView max() const;
+
+private:
+	// magnitudes, most significant word first, value i in
+	// [offsets[i], offsets[i + 1])
+	std::vector<int32_t> limbs;
+
+	std::vector<size_t> offsets;
+
+	// bit i set for a negative value i
+	std::vector<uint64_t> negative;
+
+	int signum(size_t index) const;
+
+	int compare(size_t i, size_t j) const;
+
+	size_t hash(size_t index) const;
+
+	// rebuilds the pool holding the values at the given indices in turn
+	void select(const std::vector<size_t> & indices);
+
+	// the index of the least value, or the greatest for a negative sign
+	size_t extreme(int sign) const;
+};
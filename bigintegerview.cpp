@@ -0,0 +1,337 @@
+/*
+* Paul Fulham
+*/
+
+#include <algorithm>
+
+#include "bigintegerview.h"
+#include "limbkernels.h"
+
+BigIntegerView::BigIntegerView(int signum, const int32_t * words, size_t length, Order order) :
+	order(order)
+{
+	if (signum < -1 || signum > 1)
+	{
+		throw "Invalid signum value";
+	}
+	if (order == MOST_SIGNIFICANT_FIRST)
+	{
+		while (length > 0 && words[0] == 0)
+		{
+			words++;
+			length--;
+		}
+	}
+	else
+	{
+		while (length > 0 && words[length - 1] == 0)
+		{
+			length--;
+		}
+	}
+	if (signum == 0 && length > 0)
+	{
+		throw "Signum-magnitude mismatch";
+	}
+	this->sign = length == 0 ? 0 : signum;
+	this->words = words;
+	this->len = length;
+}
+
+BigIntegerView::BigIntegerView(const BigInteger & value) :
+	sign(value.signum),
+	words(value.mag.data()),
+	len(value.mag.size()),
+	order(MOST_SIGNIFICANT_FIRST)
+{
+}
+
+int BigIntegerView::signum() const
+{
+	return this->sign;
+}
+
+size_t BigIntegerView::length() const
+{
+	return this->len;
+}
+
+int32_t BigIntegerView::word(size_t n) const
+{
+	if (n >= this->len)
+	{
+		return 0;
+	}
+	return this->order == MOST_SIGNIFICANT_FIRST ? this->words[this->len - 1 - n] : this->words[n];
+}
+
+BigInteger BigIntegerView::toBigInteger() const
+{
+	if (this->order == MOST_SIGNIFICANT_FIRST)
+	{
+		return BigInteger(this->sign, std::vector<int32_t>(this->words, this->words + this->len));
+	}
+	return BigInteger(this->sign, std::vector<int32_t>(std::reverse_iterator<const int32_t *>(this->words + this->len), std::reverse_iterator<const int32_t *>(this->words)));
+}
+
+std::string BigIntegerView::toString(int radix) const
+{
+	if (this->sign == 0)
+	{
+		return "0";
+	}
+	if (radix < BigInteger::MIN_RADIX || radix > BigInteger::MAX_RADIX)
+	{
+		radix = 10;
+	}
+	// past the threshold the recursive conversion outweighs one copy
+	if (this->len >= BigInteger::SCHOENHAGE_BASE_CONVERSION_THRESHOLD)
+	{
+		return toBigInteger().toString(radix);
+	}
+	BigInteger::Scratch::Frame frame;
+	int32_t * tmp = frame.take(this->len);
+	write(tmp, this->len);
+	std::string buf;
+	BigInteger::smallToString(this->sign, tmp, this->len, radix, buf, 0);
+	return buf;
+}
+
+int BigIntegerView::compare(const BigIntegerView & rhs) const
+{
+	if (this->sign != rhs.sign)
+	{
+		return this->sign > rhs.sign ? 1 : -1;
+	}
+	return this->sign * compareMagnitude(rhs);
+}
+
+size_t BigIntegerView::hashCode() const
+{
+	BigInteger::Scratch::Frame frame;
+	return (size_t)BigInteger::hashWords(this->sign, bigEndian(frame), this->len);
+}
+
+BigInteger BigIntegerView::divide(const BigIntegerView & val, BigInteger & quotient) const
+{
+	if (val.sign == 0)
+	{
+		throw "BigInteger divide by zero";
+	}
+	if (val.len > 2)
+	{
+		return toBigInteger().divide(val.toBigInteger(), quotient);
+	}
+	if (this->sign == 0)
+	{
+		quotient = 0;
+		return 0;
+	}
+	// a word divisor runs straight down the dividend into the quotient
+	uint64_t d = (uint64_t)(uint32_t)val.word(1) << 32 | (uint32_t)val.word(0);
+	BigInteger::Scratch::Frame frame;
+	std::vector<int32_t> q(this->len);
+	const int32_t * x = bigEndian(frame);
+	uint64_t r = d >> 32 == 0 ? BigInteger::divideByInt(x, this->len, (uint32_t)d, q.data()) : BigInteger::divideByLong(x, this->len, d, q.data());
+	BigInteger::trimLeadingZeroInts(q);
+	int sign = q.empty() ? 0 : this->sign * val.sign;
+	quotient = BigInteger(sign, std::move(q));
+	return BigInteger::valueOf(this->sign, r);
+}
+
+size_t BigIntegerView::write(int32_t * out, size_t capacity, Order order) const
+{
+	checkCapacity(this->len, capacity);
+	if (order == this->order)
+	{
+		std::copy(this->words, this->words + this->len, out);
+	}
+	else
+	{
+		std::reverse_copy(this->words, this->words + this->len, out);
+	}
+	return this->len;
+}
+
+BigIntegerView BigIntegerView::add(const BigIntegerView & lhs, const BigIntegerView & rhs, int32_t * out, size_t capacity, Order order)
+{
+	return sum(lhs, rhs, 1, out, capacity, order);
+}
+
+BigIntegerView BigIntegerView::subtract(const BigIntegerView & lhs, const BigIntegerView & rhs, int32_t * out, size_t capacity, Order order)
+{
+	return sum(lhs, rhs, -1, out, capacity, order);
+}
+
+BigIntegerView BigIntegerView::multiply(const BigIntegerView & lhs, const BigIntegerView & rhs, int32_t * out, size_t capacity, Order order)
+{
+	size_t n = lhs.len + rhs.len;
+	checkCapacity(n, capacity);
+	if (lhs.sign == 0 || rhs.sign == 0)
+	{
+		return BigIntegerView(0, out, 0, order);
+	}
+	if (lhs.len >= BigInteger::KARATSUBA_THRESHOLD && rhs.len >= BigInteger::KARATSUBA_THRESHOLD)
+	{
+		// Karatsuba works on whole BigIntegers, which cost only a copy here.
+		// The product is laid out in n words as the schoolbook one is, so a
+		// product a word short still ends where its caller expects
+		BigInteger product = lhs.toBigInteger() * rhs.toBigInteger();
+		size_t size = product.mag.size();
+		if (order == MOST_SIGNIFICANT_FIRST)
+		{
+			std::fill(out, out + (n - size), 0);
+			BigIntegerView(product).write(out + (n - size), size, order);
+		}
+		else
+		{
+			BigIntegerView(product).write(out, size, order);
+			std::fill(out + size, out + n, 0);
+		}
+		return BigIntegerView(product.signum, out, n, order);
+	}
+	BigInteger::Scratch::Frame frame;
+	const int32_t * x = lhs.bigEndian(frame);
+	const int32_t * y = rhs.bigEndian(frame);
+	if (order == MOST_SIGNIFICANT_FIRST)
+	{
+		LimbKernels::multiply(x, lhs.len, y, rhs.len, out);
+	}
+	else
+	{
+		int32_t * z = frame.take(n);
+		LimbKernels::multiply(x, lhs.len, y, rhs.len, z);
+		std::reverse_copy(z, z + n, out);
+	}
+	return BigIntegerView(lhs.sign * rhs.sign, out, n, order);
+}
+
+BigInteger operator+(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	std::vector<int32_t> words(std::max(lhs.len, rhs.len) + 1);
+	BigIntegerView result = BigIntegerView::sum(lhs, rhs, 1, words.data(), words.size(), BigIntegerView::MOST_SIGNIFICANT_FIRST);
+	return BigIntegerView::adopt(result, words);
+}
+
+BigInteger operator-(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	std::vector<int32_t> words(std::max(lhs.len, rhs.len) + 1);
+	BigIntegerView result = BigIntegerView::sum(lhs, rhs, -1, words.data(), words.size(), BigIntegerView::MOST_SIGNIFICANT_FIRST);
+	return BigIntegerView::adopt(result, words);
+}
+
+BigInteger operator*(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	std::vector<int32_t> words(lhs.len + rhs.len);
+	BigIntegerView result = BigIntegerView::multiply(lhs, rhs, words.data(), words.size(), BigIntegerView::MOST_SIGNIFICANT_FIRST);
+	return BigIntegerView::adopt(result, words);
+}
+
+bool operator<(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	return lhs.compare(rhs) < 0;
+}
+
+bool operator>(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	return lhs.compare(rhs) > 0;
+}
+
+bool operator<=(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	return lhs.compare(rhs) <= 0;
+}
+
+bool operator>=(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	return lhs.compare(rhs) >= 0;
+}
+
+bool operator==(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	return lhs.compare(rhs) == 0;
+}
+
+bool operator!=(const BigIntegerView & lhs, const BigIntegerView & rhs)
+{
+	return lhs.compare(rhs) != 0;
+}
+
+std::ostream & operator<<(std::ostream & output, const BigIntegerView & value)
+{
+	return output << value.toString();
+}
+
+const int32_t * BigIntegerView::bigEndian(BigInteger::Scratch::Frame & frame) const
+{
+	if (this->order == MOST_SIGNIFICANT_FIRST)
+	{
+		return this->words;
+	}
+	int32_t * copy = frame.take(this->len);
+	std::reverse_copy(this->words, this->words + this->len, copy);
+	return copy;
+}
+
+int BigIntegerView::compareMagnitude(const BigIntegerView & rhs) const
+{
+	if (this->len != rhs.len)
+	{
+		return this->len < rhs.len ? -1 : 1;
+	}
+	for (size_t i = this->len; i-- > 0; )
+	{
+		uint32_t a = (uint32_t)word(i), b = (uint32_t)rhs.word(i);
+		if (a != b)
+		{
+			return a < b ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+BigIntegerView BigIntegerView::sum(const BigIntegerView & lhs, const BigIntegerView & rhs, int sign, int32_t * out, size_t capacity, Order order)
+{
+	size_t n = std::max(lhs.len, rhs.len) + 1;
+	checkCapacity(n, capacity);
+	int rsign = rhs.sign * sign;
+	// like signs add magnitudes, unlike ones take the smaller from the larger
+	const BigIntegerView * big = &lhs, * little = &rhs;
+	int resultSign = lhs.sign != 0 ? lhs.sign : rsign;
+	bool difference = lhs.sign * rsign < 0;
+	if (difference)
+	{
+		int cmp = lhs.compareMagnitude(rhs);
+		if (cmp < 0)
+		{
+			std::swap(big, little);
+			resultSign = rsign;
+		}
+		else if (cmp == 0)
+		{
+			resultSign = 0;
+		}
+	}
+	int64_t carry = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		int64_t t = (int64_t)(uint32_t)big->word(i) + (difference ? -(int64_t)(uint32_t)little->word(i) : (int64_t)(uint32_t)little->word(i)) + carry;
+		out[order == MOST_SIGNIFICANT_FIRST ? n - 1 - i : i] = (int32_t)t;
+		carry = t >> 32;
+	}
+	return BigIntegerView(resultSign, out, n, order);
+}
+
+BigInteger BigIntegerView::adopt(const BigIntegerView & result, std::vector<int32_t> & words)
+{
+	words.erase(words.begin(), words.end() - result.len);
+	return BigInteger(result.sign, std::move(words));
+}
+
+void BigIntegerView::checkCapacity(size_t needed, size_t capacity)
+{
+	if (needed > capacity)
+	{
+		throw "Output span too small";
+	}
+}
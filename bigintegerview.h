@@ -0,0 +1,120 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include "biginteger.h"
+
+// A read-only value over magnitude words held elsewhere, such as a memory
+// mapped table or a network buffer, given as a sign and a pointer to length
+// words stored in either order. Nothing is copied to make one, and the words
+// must outlive it. Comparison, addition, multiplication, division and
+// conversion to a string read the words where they lie, and the span forms
+// write their result into words the caller provides. A BigInteger converts
+// to a view of its own words, so either kind mixes with the other
+class BigIntegerView
+{
+public:
+	enum Order
+	{
+		MOST_SIGNIFICANT_FIRST,
+		LEAST_SIGNIFICANT_FIRST
+	};
+
+	// leading zero words are skipped, and a zero magnitude is zero whatever
+	// sign it is given
+	BigIntegerView(int signum, const int32_t * words, size_t length, Order order = MOST_SIGNIFICANT_FIRST);
+
+	BigIntegerView(const BigInteger & value);
+
+	int signum() const;
+
+	// the words of the magnitude without its leading zeros
+	size_t length() const;
+
+	// word n of the magnitude, counting from the least significant
+	int32_t word(size_t n) const;
+
+	BigInteger toBigInteger() const;
+
+	std::string toString(int radix = 10) const;
+
+	int compare(const BigIntegerView & rhs) const;
+
+	// the same as BigInteger::hashCode for an equal value
+	size_t hashCode() const;
+
+	// the remainder, with quotient set as BigInteger::divide does
+	BigInteger divide(const BigIntegerView & val, BigInteger & quotient) const;
+
+	// the magnitude into out in the given order, returning the words
+	// written; throws if it needs more than capacity
+	size_t write(int32_t * out, size_t capacity, Order order = MOST_SIGNIFICANT_FIRST) const;
+
+	// Each of these writes its result into out, which must not overlap either
+	// operand, and returns a view of it. A sum needs one word more than the
+	// longer operand and a product the length of both, or they throw
+	static BigIntegerView add(const BigIntegerView & lhs, const BigIntegerView & rhs, int32_t * out, size_t capacity, Order order = MOST_SIGNIFICANT_FIRST);
+
+	static BigIntegerView subtract(const BigIntegerView & lhs, const BigIntegerView & rhs, int32_t * out, size_t capacity, Order order = MOST_SIGNIFICANT_FIRST);
+
+	static BigIntegerView multiply(const BigIntegerView & lhs, const BigIntegerView & rhs, int32_t * out, size_t capacity, Order order = MOST_SIGNIFICANT_FIRST);
+
+	friend BigInteger operator+(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend BigInteger operator-(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend BigInteger operator*(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend bool operator<(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend bool operator>(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend bool operator<=(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend bool operator>=(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend bool operator==(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend bool operator!=(const BigIntegerView & lhs, const BigIntegerView & rhs);
+
+	friend std::ostream & operator<<(std::ostream & output, const BigIntegerView & value);
+
+private:
+	friend class BigAccumulator;
+
+	int sign;
+
+	const int32_t * words;
+
+	size_t len;
+
+	Order order;
+
+	// the magnitude as big-endian words, pointing into the view itself when
+	// it is stored that way and into scratch otherwise
+	const int32_t * bigEndian(BigInteger::Scratch::Frame & frame) const;
+
+	int compareMagnitude(const BigIntegerView & rhs) const;
+
+	// lhs + sign * rhs into out as a view
+	static BigIntegerView sum(const BigIntegerView & lhs, const BigIntegerView & rhs, int sign, int32_t * out, size_t capacity, Order order);
+
+	// a BigInteger taking over the big-endian words result views
+	static BigInteger adopt(const BigIntegerView & result, std::vector<int32_t> & words);
+
+	static void checkCapacity(size_t needed, size_t capacity);
+};
+
+namespace std
+{
+	template <>
+	struct hash<BigIntegerView>
+	{
+		size_t operator()(const BigIntegerView & value) const
+		{
+			return value.hashCode();
+		}
+	};
+}
@@ -0,0 +1,103 @@
+/*
+* Paul Fulham
+*/
+
+#include "fixedbasetable.h"
+
+FixedBaseTable::FixedBaseTable(const BigInteger & base, const BigInteger & modulus, size_t maxExponentBits, int windowBits) :
+	g(base.mod(modulus)),
+	m(modulus),
+	maxBits(maxExponentBits),
+	width(windowBits)
+{
+	if (windowBits < 1 || windowBits > 16)
+	{
+		throw "Window size out of range";
+	}
+	// table[i][j - 1] = base^(j * 2^(width * i)), so a power is one
+	// multiplication per window of the exponent and no squarings
+	size_t windows = (maxExponentBits + windowBits - 1) / windowBits;
+	BigInteger windowBase = this->g;
+	for (size_t i = 0; i < windows; i++)
+	{
+		std::vector<BigInteger> row{ windowBase };
+		for (int j = 2; j < 1 << windowBits; j++)
+		{
+			row.push_back((row.back() * windowBase).mod(modulus));
+		}
+		windowBase = (row.back() * windowBase).mod(modulus);
+		this->table.push_back(std::move(row));
+	}
+}
+
+const BigInteger & FixedBaseTable::base() const
+{
+	return this->g;
+}
+
+const BigInteger & FixedBaseTable::modulus() const
+{
+	return this->m;
+}
+
+BigInteger FixedBaseTable::pow(const BigInteger & exponent) const
+{
+	if (!covers(exponent))
+	{
+		return this->g.modPow(exponent, this->m);
+	}
+	BigInteger result = 1;
+	accumulate(exponent, result);
+	return result.mod(this->m);
+}
+
+BigInteger FixedBaseTable::multiPow(const std::vector<const FixedBaseTable *> & tables, const std::vector<BigInteger> & exponents)
+{
+	if (tables.size() != exponents.size())
+	{
+		throw "Mismatched multiPow lengths";
+	}
+	if (tables.empty())
+	{
+		return 1;
+	}
+	const BigInteger & m = tables[0]->m;
+	BigInteger result = 1;
+	for (size_t i = 0; i < tables.size(); i++)
+	{
+		if (tables[i]->m != m)
+		{
+			throw "Mismatched multiPow modulus";
+		}
+		if (tables[i]->covers(exponents[i]))
+		{
+			tables[i]->accumulate(exponents[i], result);
+		}
+		else
+		{
+			result = (result * tables[i]->pow(exponents[i])).mod(m);
+		}
+	}
+	return result.mod(m);
+}
+
+bool FixedBaseTable::covers(const BigInteger & exponent) const
+{
+	return exponent >= 0 && exponent.bitLength() <= this->maxBits;
+}
+
+void FixedBaseTable::accumulate(const BigInteger & exponent, BigInteger & result) const
+{
+	for (size_t i = 0; i * this->width < exponent.bitLength(); i++)
+	{
+		int digit = 0;
+		for (int k = this->width; k-- > 0; )
+		{
+			digit = (digit << 1) | (exponent.testBit((int32_t)(i * this->width + k)) ? 1 : 0);
+		}
+		if (digit != 0)
+		{
+			result = (result * this->table[i][digit - 1]).mod(this->m);
+		}
+	}
+}
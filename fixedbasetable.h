@@ -0,0 +1,36 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include "biginteger.h"
+
+class FixedBaseTable
+{
+public:
+	FixedBaseTable(const BigInteger & base, const BigInteger & modulus, size_t maxExponentBits, int windowBits = 4);
+
+	const BigInteger & base() const;
+
+	const BigInteger & modulus() const;
+
+	BigInteger pow(const BigInteger & exponent) const;
+
+	static BigInteger multiPow(const std::vector<const FixedBaseTable *> & tables, const std::vector<BigInteger> & exponents);
+
+private:
+	BigInteger g;
+
+	BigInteger m;
+
+	size_t maxBits;
+
+	int width;
+
+	std::vector<std::vector<BigInteger>> table;
+
+	bool covers(const BigInteger & exponent) const;
+
+	void accumulate(const BigInteger & exponent, BigInteger & result) const;
+};
@@ -0,0 +1,534 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include <inttypes.h>
+
+#include "biginteger.h"
+
+// Every word loop below runs a number of times fixed by the width, which the
+// compiler is asked to unroll
+#if defined(__clang__)
+#define FIXED_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+#define FIXED_UNROLL _Pragma("GCC unroll 16")
+#else
+#define FIXED_UNROLL
+#endif
+
+// An unsigned integer of exactly Bits bits held in little-endian 32 bit words
+// inside the object, so it never allocates and never normalizes. Arithmetic
+// wraps modulo 2^Bits like the built in unsigned types, and everything but
+// the conversions to and from BigInteger can run in a constant expression
+template <size_t Bits>
+class FixedBigInt
+{
+	static_assert(Bits > 0 && Bits % 32 == 0, "FixedBigInt width must be a positive multiple of 32 bits");
+
+public:
+	static constexpr size_t WORDS = Bits / 32;
+
+	class Montgomery;
+
+	constexpr FixedBigInt();
+
+	constexpr FixedBigInt(uint64_t val);
+
+	explicit FixedBigInt(const BigInteger & val);
+
+	// digits in the given radix, with no sign
+	static constexpr FixedBigInt parse(const char * digits, int radix = 10);
+
+	BigInteger toBigInteger() const;
+
+	constexpr uint32_t word(size_t n) const;
+
+	constexpr bool testBit(size_t n) const;
+
+	constexpr size_t bitLength() const;
+
+	constexpr bool operator==(const FixedBigInt & rhs) const;
+
+	constexpr bool operator!=(const FixedBigInt & rhs) const;
+
+	constexpr bool operator<(const FixedBigInt & rhs) const;
+
+	constexpr bool operator>(const FixedBigInt & rhs) const;
+
+	constexpr bool operator<=(const FixedBigInt & rhs) const;
+
+	constexpr bool operator>=(const FixedBigInt & rhs) const;
+
+	constexpr FixedBigInt operator+(const FixedBigInt & rhs) const;
+
+	constexpr FixedBigInt operator-(const FixedBigInt & rhs) const;
+
+	constexpr FixedBigInt operator*(const FixedBigInt & rhs) const;
+
+	constexpr FixedBigInt & operator+=(const FixedBigInt & rhs);
+
+	constexpr FixedBigInt & operator-=(const FixedBigInt & rhs);
+
+	constexpr FixedBigInt & operator*=(const FixedBigInt & rhs);
+
+	// the kernels behind the operators, returning what does not fit
+	static constexpr uint32_t add(const FixedBigInt & a, const FixedBigInt & b, FixedBigInt & sum);
+
+	static constexpr uint32_t subtract(const FixedBigInt & a, const FixedBigInt & b, FixedBigInt & difference);
+
+	static constexpr uint32_t multiplyAdd(const FixedBigInt & a, uint32_t b, uint32_t c, FixedBigInt & result);
+
+	static constexpr void multiply(const FixedBigInt & a, const FixedBigInt & b, FixedBigInt & low, FixedBigInt & high);
+
+private:
+	uint32_t words[WORDS];
+
+	constexpr int compare(const FixedBigInt & rhs) const;
+};
+
+// Arithmetic modulo an odd modulus on values kept multiplied by R = 2^Bits,
+// where reducing a product needs only multiplications and a shift
+template <size_t Bits>
+class FixedBigInt<Bits>::Montgomery
+{
+public:
+	constexpr Montgomery(const FixedBigInt & modulus);
+
+	constexpr const FixedBigInt & modulus() const;
+
+	constexpr FixedBigInt toMontgomery(const FixedBigInt & a) const;
+
+	constexpr FixedBigInt fromMontgomery(const FixedBigInt & a) const;
+
+	// both in Montgomery form, the product stays in it
+	constexpr FixedBigInt multiply(const FixedBigInt & a, const FixedBigInt & b) const;
+
+	// base and result in the ordinary form
+	constexpr FixedBigInt pow(const FixedBigInt & base, const FixedBigInt & exponent) const;
+
+private:
+	FixedBigInt m;
+
+	uint32_t inverse;
+
+	FixedBigInt one;
+
+	FixedBigInt r2;
+
+	constexpr FixedBigInt twice(const FixedBigInt & a) const;
+};
+
+template <size_t Bits>
+constexpr size_t FixedBigInt<Bits>::WORDS;
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits>::FixedBigInt() :
+	words {}
+{
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits>::FixedBigInt(uint64_t val) :
+	words {}
+{
+	for (size_t i = 0; i < WORDS && i < 2; i++)
+	{
+		this->words[i] = (uint32_t)(val >> (32 * i));
+	}
+}
+
+template <size_t Bits>
+FixedBigInt<Bits>::FixedBigInt(const BigInteger & val) :
+	words {}
+{
+	if (val.signum < 0 || val.mag.size() > WORDS)
+	{
+		throw "BigInteger does not fit in FixedBigInt";
+	}
+	for (size_t i = 0; i < val.mag.size(); i++)
+	{
+		this->words[i] = (uint32_t)val.mag[val.mag.size() - 1 - i];
+	}
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::parse(const char * digits, int radix)
+{
+	if (radix < BigInteger::MIN_RADIX || radix > BigInteger::MAX_RADIX)
+	{
+		throw "Radix out of range";
+	}
+	if (*digits == '\0')
+	{
+		throw "Zero length FixedBigInt";
+	}
+	FixedBigInt result;
+	for (; *digits != '\0'; digits++)
+	{
+		char c = *digits;
+		int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'z' ? c - 'a' + 10 : c >= 'A' && c <= 'Z' ? c - 'A' + 10 : radix;
+		if (digit >= radix)
+		{
+			throw "Illegal digit";
+		}
+		if (multiplyAdd(result, (uint32_t)radix, (uint32_t)digit, result) != 0)
+		{
+			throw "Value does not fit in FixedBigInt";
+		}
+	}
+	return result;
+}
+
+template <size_t Bits>
+BigInteger FixedBigInt<Bits>::toBigInteger() const
+{
+	size_t len = WORDS;
+	while (len > 0 && this->words[len - 1] == 0)
+	{
+		len--;
+	}
+	std::vector<int32_t> mag(len);
+	for (size_t i = 0; i < len; i++)
+	{
+		mag[i] = (int32_t)this->words[len - 1 - i];
+	}
+	return BigInteger(1, mag);
+}
+
+template <size_t Bits>
+constexpr uint32_t FixedBigInt<Bits>::word(size_t n) const
+{
+	return n < WORDS ? this->words[n] : 0;
+}
+
+template <size_t Bits>
+constexpr bool FixedBigInt<Bits>::testBit(size_t n) const
+{
+	return (word(n / 32) >> (n % 32) & 1) != 0;
+}
+
+template <size_t Bits>
+constexpr size_t FixedBigInt<Bits>::bitLength() const
+{
+	for (size_t i = WORDS; i-- > 0; )
+	{
+		if (this->words[i] != 0)
+		{
+			size_t bits = 32 * i;
+			for (uint32_t w = this->words[i]; w != 0; w >>= 1)
+			{
+				bits++;
+			}
+			return bits;
+		}
+	}
+	return 0;
+}
+
+template <size_t Bits>
+constexpr bool FixedBigInt<Bits>::operator==(const FixedBigInt & rhs) const
+{
+	return compare(rhs) == 0;
+}
+
+template <size_t Bits>
+constexpr bool FixedBigInt<Bits>::operator!=(const FixedBigInt & rhs) const
+{
+	return compare(rhs) != 0;
+}
+
+template <size_t Bits>
+constexpr bool FixedBigInt<Bits>::operator<(const FixedBigInt & rhs) const
+{
+	return compare(rhs) < 0;
+}
+
+template <size_t Bits>
+constexpr bool FixedBigInt<Bits>::operator>(const FixedBigInt & rhs) const
+{
+	return compare(rhs) > 0;
+}
+
+template <size_t Bits>
+constexpr bool FixedBigInt<Bits>::operator<=(const FixedBigInt & rhs) const
+{
+	return compare(rhs) <= 0;
+}
+
+template <size_t Bits>
+constexpr bool FixedBigInt<Bits>::operator>=(const FixedBigInt & rhs) const
+{
+	return compare(rhs) >= 0;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::operator+(const FixedBigInt & rhs) const
+{
+	FixedBigInt sum;
+	add(*this, rhs, sum);
+	return sum;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::operator-(const FixedBigInt & rhs) const
+{
+	FixedBigInt difference;
+	subtract(*this, rhs, difference);
+	return difference;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::operator*(const FixedBigInt & rhs) const
+{
+	// only the low half is kept, so products past the width are never formed
+	FixedBigInt product;
+	FIXED_UNROLL
+	for (size_t i = 0; i < WORDS; i++)
+	{
+		uint64_t carry = 0;
+		FIXED_UNROLL
+		for (size_t j = 0; i + j < WORDS; j++)
+		{
+			uint64_t t = (uint64_t)this->words[i] * rhs.words[j] + product.words[i + j] + carry;
+			product.words[i + j] = (uint32_t)t;
+			carry = t >> 32;
+		}
+	}
+	return product;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> & FixedBigInt<Bits>::operator+=(const FixedBigInt & rhs)
+{
+	add(*this, rhs, *this);
+	return *this;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> & FixedBigInt<Bits>::operator-=(const FixedBigInt & rhs)
+{
+	subtract(*this, rhs, *this);
+	return *this;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> & FixedBigInt<Bits>::operator*=(const FixedBigInt & rhs)
+{
+	return *this = *this * rhs;
+}
+
+template <size_t Bits>
+constexpr uint32_t FixedBigInt<Bits>::add(const FixedBigInt & a, const FixedBigInt & b, FixedBigInt & sum)
+{
+	uint64_t carry = 0;
+	FIXED_UNROLL
+	for (size_t i = 0; i < WORDS; i++)
+	{
+		uint64_t t = (uint64_t)a.words[i] + b.words[i] + carry;
+		sum.words[i] = (uint32_t)t;
+		carry = t >> 32;
+	}
+	return (uint32_t)carry;
+}
+
+template <size_t Bits>
+constexpr uint32_t FixedBigInt<Bits>::subtract(const FixedBigInt & a, const FixedBigInt & b, FixedBigInt & difference)
+{
+	uint64_t borrow = 0;
+	FIXED_UNROLL
+	for (size_t i = 0; i < WORDS; i++)
+	{
+		uint64_t t = (uint64_t)a.words[i] - b.words[i] - borrow;
+		difference.words[i] = (uint32_t)t;
+		borrow = t >> 63;
+	}
+	return (uint32_t)borrow;
+}
+
+template <size_t Bits>
+constexpr uint32_t FixedBigInt<Bits>::multiplyAdd(const FixedBigInt & a, uint32_t b, uint32_t c, FixedBigInt & result)
+{
+	uint64_t carry = c;
+	FIXED_UNROLL
+	for (size_t i = 0; i < WORDS; i++)
+	{
+		uint64_t t = (uint64_t)a.words[i] * b + carry;
+		result.words[i] = (uint32_t)t;
+		carry = t >> 32;
+	}
+	return (uint32_t)carry;
+}
+
+template <size_t Bits>
+constexpr void FixedBigInt<Bits>::multiply(const FixedBigInt & a, const FixedBigInt & b, FixedBigInt & low, FixedBigInt & high)
+{
+	uint32_t product[2 * WORDS] = {};
+	FIXED_UNROLL
+	for (size_t i = 0; i < WORDS; i++)
+	{
+		uint64_t carry = 0;
+		FIXED_UNROLL
+		for (size_t j = 0; j < WORDS; j++)
+		{
+			uint64_t t = (uint64_t)a.words[i] * b.words[j] + product[i + j] + carry;
+			product[i + j] = (uint32_t)t;
+			carry = t >> 32;
+		}
+		product[i + WORDS] = (uint32_t)carry;
+	}
+	for (size_t i = 0; i < WORDS; i++)
+	{
+		low.words[i] = product[i];
+		high.words[i] = product[i + WORDS];
+	}
+}
+
+template <size_t Bits>
+constexpr int FixedBigInt<Bits>::compare(const FixedBigInt & rhs) const
+{
+	for (size_t i = WORDS; i-- > 0; )
+	{
+		if (this->words[i] != rhs.words[i])
+		{
+			return this->words[i] < rhs.words[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits>::Montgomery::Montgomery(const FixedBigInt & modulus) :
+	m(modulus),
+	inverse(0),
+	one(),
+	r2()
+{
+	if (!modulus.testBit(0) || modulus.bitLength() < 2)
+	{
+		throw "Montgomery modulus must be odd and greater than one";
+	}
+	// each Newton step doubles the correct low bits of 1 / m, and an odd m is
+	// its own inverse to three bits
+	uint32_t x = modulus.words[0];
+	for (int i = 0; i < 4; i++)
+	{
+		x *= 2 - modulus.words[0] * x;
+	}
+	this->inverse = 0 - x;
+	// R mod m by doubling the highest power of two below m, which needs no
+	// division and only a step or two for a modulus of the full width
+	size_t top = modulus.bitLength() - 1;
+	this->one.words[top / 32] = (uint32_t)1 << (top % 32);
+	for (size_t i = top; i < Bits; i++)
+	{
+		this->one = twice(this->one);
+	}
+	// squaring 2^s R in Montgomery form gives 2^2s R, so with s 2^t = Bits
+	// the last square is 2^Bits R, which is R^2 mod m
+	size_t t = 0;
+	while ((Bits >> t) % 2 == 0)
+	{
+		t++;
+	}
+	this->r2 = this->one;
+	for (size_t i = 0; i < (Bits >> t); i++)
+	{
+		this->r2 = twice(this->r2);
+	}
+	for (size_t i = 0; i < t; i++)
+	{
+		this->r2 = multiply(this->r2, this->r2);
+	}
+}
+
+template <size_t Bits>
+constexpr const FixedBigInt<Bits> & FixedBigInt<Bits>::Montgomery::modulus() const
+{
+	return this->m;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::Montgomery::toMontgomery(const FixedBigInt & a) const
+{
+	return multiply(a, this->r2);
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::Montgomery::fromMontgomery(const FixedBigInt & a) const
+{
+	return multiply(a, 1);
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::Montgomery::multiply(const FixedBigInt & a, const FixedBigInt & b) const
+{
+	// coarsely integrated operand scanning, each row adds one word of the
+	// product and then a multiple of m that clears the lowest word
+	uint32_t t[WORDS + 2] = {};
+	FIXED_UNROLL
+	for (size_t i = 0; i < WORDS; i++)
+	{
+		uint64_t carry = 0;
+		FIXED_UNROLL
+		for (size_t j = 0; j < WORDS; j++)
+		{
+			uint64_t s = (uint64_t)a.words[j] * b.words[i] + t[j] + carry;
+			t[j] = (uint32_t)s;
+			carry = s >> 32;
+		}
+		uint64_t s = (uint64_t)t[WORDS] + carry;
+		t[WORDS] = (uint32_t)s;
+		t[WORDS + 1] = (uint32_t)(s >> 32);
+		uint32_t q = t[0] * this->inverse;
+		carry = ((uint64_t)q * this->m.words[0] + t[0]) >> 32;
+		FIXED_UNROLL
+		for (size_t j = 1; j < WORDS; j++)
+		{
+			s = (uint64_t)q * this->m.words[j] + t[j] + carry;
+			t[j - 1] = (uint32_t)s;
+			carry = s >> 32;
+		}
+		s = (uint64_t)t[WORDS] + carry;
+		t[WORDS - 1] = (uint32_t)s;
+		t[WORDS] = t[WORDS + 1] + (uint32_t)(s >> 32);
+	}
+	FixedBigInt result;
+	for (size_t i = 0; i < WORDS; i++)
+	{
+		result.words[i] = t[i];
+	}
+	if (t[WORDS] != 0 || result >= this->m)
+	{
+		result -= this->m;
+	}
+	return result;
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::Montgomery::pow(const FixedBigInt & base, const FixedBigInt & exponent) const
+{
+	FixedBigInt x = toMontgomery(base);
+	FixedBigInt result = this->one;
+	for (size_t i = exponent.bitLength(); i-- > 0; )
+	{
+		result = multiply(result, result);
+		if (exponent.testBit(i))
+		{
+			result = multiply(result, x);
+		}
+	}
+	return fromMontgomery(result);
+}
+
+template <size_t Bits>
+constexpr FixedBigInt<Bits> FixedBigInt<Bits>::Montgomery::twice(const FixedBigInt & a) const
+{
+	FixedBigInt result;
+	if (add(a, a, result) != 0 || result >= this->m)
+	{
+		result -= this->m;
+	}
+	return result;
+}
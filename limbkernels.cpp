@@ -0,0 +1,601 @@
+/*
+* Paul Fulham
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "biginteger.h"
+#include "limbkernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LIMB_KERNELS_X64
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// MSVC compiles intrinsics for any instruction set without flags, while
+// GCC and Clang need each kernel marked with the instructions it may use
+#if defined(__GNUC__)
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define KERNEL_TARGET(isa)
+#define KERNEL_INLINE __forceinline
+#endif
+
+// below this many words on the shorter side, repacking into 64 bit limbs
+// costs more than the wide multiply saves
+static const size_t WIDE_MULTIPLY_THRESHOLD = TUNED_WIDE_MULTIPLY_THRESHOLD;
+
+static void multiplyScalar(const int32_t * x, size_t xlen, const int32_t * y, size_t ylen, int32_t * z)
+{
+	size_t xstart = xlen - 1;
+	uint64_t carry = 0;
+	for (size_t j = ylen, k = ylen + 1 + xstart; j-- > 0; )
+	{
+		uint64_t product = (uint64_t)(uint32_t)y[j] * (uint32_t)x[xstart] + carry;
+		z[--k] = (int32_t)product;
+		carry = product >> 32;
+	}
+	z[xstart] = (int32_t)carry;
+	for (size_t i = xstart; i-- > 0; )
+	{
+		carry = 0;
+		for (size_t j = ylen, k = ylen + 1 + i; j-- > 0; )
+		{
+			uint64_t product = (uint64_t)(uint32_t)y[j] * (uint32_t)x[i] + (uint32_t)z[--k] + carry;
+			z[k] = (int32_t)product;
+			carry = product >> 32;
+		}
+		z[i] = (int32_t)carry;
+	}
+}
+
+static void bitwiseScalar(LimbKernels::Bitwise op, int32_t * dst, const int32_t * a, const int32_t * b, size_t len)
+{
+	switch (op)
+	{
+	case LimbKernels::AND:
+		for (size_t i = 0; i < len; i++)
+		{
+			dst[i] = a[i] & b[i];
+		}
+		break;
+	case LimbKernels::OR:
+		for (size_t i = 0; i < len; i++)
+		{
+			dst[i] = a[i] | b[i];
+		}
+		break;
+	case LimbKernels::XOR:
+		for (size_t i = 0; i < len; i++)
+		{
+			dst[i] = a[i] ^ b[i];
+		}
+		break;
+	case LimbKernels::AND_NOT:
+		for (size_t i = 0; i < len; i++)
+		{
+			dst[i] = a[i] & ~b[i];
+		}
+		break;
+	}
+}
+
+static int popCountScalar(const int32_t * x, size_t len)
+{
+	int count = 0;
+	for (size_t n = 0; n < len; n++)
+	{
+		uint32_t i = (uint32_t)x[n];
+		i = i - ((i >> 1) & 0x55555555);
+		i = (i & 0x33333333) + ((i >> 2) & 0x33333333);
+		i = (i + (i >> 4)) & 0x0F0F0F0F;
+		count += (int)((i * 0x01010101) >> 24);
+	}
+	return count;
+}
+
+static int32_t addScalar(int32_t * z, const int32_t * x, const int32_t * y, size_t len)
+{
+	uint64_t sum = 0;
+	for (size_t i = len; i-- > 0; )
+	{
+		sum = (uint64_t)(uint32_t)x[i] + (uint32_t)y[i] + (sum >> 32);
+		z[i] = (int32_t)sum;
+	}
+	return (int32_t)(sum >> 32);
+}
+
+static int32_t subtractScalar(int32_t * z, const int32_t * x, const int32_t * y, size_t len)
+{
+	int64_t difference = 0;
+	for (size_t i = len; i-- > 0; )
+	{
+		difference = (int64_t)(uint32_t)x[i] - (uint32_t)y[i] + (difference >> 32);
+		z[i] = (int32_t)difference;
+	}
+	return difference < 0 ? 1 : 0;
+}
+
+static int32_t mulsubScalar(int32_t * q, const int32_t * a, int32_t x, size_t len)
+{
+	uint64_t carry = 0;
+	for (size_t j = len; j-- > 0; )
+	{
+		uint64_t product = (uint64_t)(uint32_t)a[j] * (uint32_t)x + carry;
+		uint32_t difference = (uint32_t)q[j] - (uint32_t)product;
+		q[j] = (int32_t)difference;
+		carry = (product >> 32) + (difference > ~(uint32_t)product ? 1 : 0);
+	}
+	return (int32_t)carry;
+}
+
+static int32_t multiplyAddScalar(int32_t * x, size_t len, int32_t y, int32_t z)
+{
+	uint64_t carry = (uint32_t)z;
+	for (size_t i = len; i-- > 0; )
+	{
+		uint64_t product = (uint64_t)(uint32_t)y * (uint32_t)x[i] + carry;
+		x[i] = (int32_t)product;
+		carry = product >> 32;
+	}
+	return (int32_t)carry;
+}
+
+static void shiftLeftScalar(int32_t * dst, const int32_t * x, size_t len, int shift)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		dst[i] = (int32_t)((uint32_t)x[i] << shift | (uint32_t)x[i + 1] >> (32 - shift));
+	}
+}
+
+#if defined(LIMB_KERNELS_X64)
+
+// a * b + c + d never exceeds 2^128 - 1, so the high word takes every carry
+static KERNEL_INLINE uint64_t mulAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t & high)
+{
+#if defined(_MSC_VER)
+	uint64_t low = _umul128(a, b, &high);
+	high += _addcarry_u64(0, low, c, &low);
+	high += _addcarry_u64(0, low, d, &low);
+	return low;
+#else
+	unsigned __int128 t = (unsigned __int128)a * b + c + d;
+	high = (uint64_t)(t >> 64);
+	return (uint64_t)t;
+#endif
+}
+
+// big-endian 32 bit words to little-endian 64 bit limbs
+static KERNEL_INLINE void pack(const int32_t * x, size_t len, uint64_t * out)
+{
+	for (size_t k = 0; 2 * k < len; k++)
+	{
+		size_t low = len - 1 - 2 * k;
+		uint64_t word = (uint32_t)x[low];
+		if (low > 0)
+		{
+			word |= (uint64_t)(uint32_t)x[low - 1] << 32;
+		}
+		out[k] = word;
+	}
+}
+
+// two big-endian words as one 64 bit limb, the first being its high half
+static KERNEL_INLINE uint64_t load(const int32_t * x)
+{
+	uint64_t word;
+	std::memcpy(&word, x, sizeof(word));
+	return word << 32 | word >> 32;
+}
+
+static KERNEL_INLINE void store(int32_t * x, uint64_t word)
+{
+	word = word << 32 | word >> 32;
+	std::memcpy(x, &word, sizeof(word));
+}
+
+// BMI2's flagless mulx leaves the add chain free to overlap the multiplies,
+// and 64 bit limbs need a quarter of the products of 32 bit words; work
+// holds 2 * (xn + yn) zeroed limbs
+KERNEL_TARGET("bmi2") static void multiplyBmi2(const int32_t * x, size_t xlen, const int32_t * y, size_t ylen, int32_t * z, uint64_t * work)
+{
+	size_t xn = (xlen + 1) / 2;
+	size_t yn = (ylen + 1) / 2;
+	uint64_t * a = work;
+	uint64_t * b = a + xn;
+	uint64_t * r = b + yn;
+	pack(x, xlen, a);
+	pack(y, ylen, b);
+	for (size_t i = 0; i < xn; i++)
+	{
+		uint64_t carry = 0;
+		for (size_t j = 0; j < yn; j++)
+		{
+			r[i + j] = mulAdd(a[i], b[j], r[i + j], carry, carry);
+		}
+		r[i + yn] = carry;
+	}
+	size_t zlen = xlen + ylen;
+	for (size_t m = 0; m < zlen; m++)
+	{
+		z[zlen - 1 - m] = (int32_t)(r[m / 2] >> (32 * (m & 1)));
+	}
+}
+
+// The carry chains below run over word pairs read as 64 bit limbs from the
+// least significant end, halving the steps of the scalar loops, with any
+// odd word at the top done on its own
+
+KERNEL_TARGET("bmi2") static int32_t addBmi2(int32_t * z, const int32_t * x, const int32_t * y, size_t len)
+{
+	unsigned char carry = 0;
+	size_t i = len;
+	for (; i >= 2; i -= 2)
+	{
+		unsigned long long sum;
+		carry = _addcarry_u64(carry, load(x + i - 2), load(y + i - 2), &sum);
+		store(z + i - 2, sum);
+	}
+	if (i == 1)
+	{
+		uint64_t sum = (uint64_t)(uint32_t)x[0] + (uint32_t)y[0] + carry;
+		z[0] = (int32_t)sum;
+		return (int32_t)(sum >> 32);
+	}
+	return carry;
+}
+
+KERNEL_TARGET("bmi2") static int32_t subtractBmi2(int32_t * z, const int32_t * x, const int32_t * y, size_t len)
+{
+	unsigned char borrow = 0;
+	size_t i = len;
+	for (; i >= 2; i -= 2)
+	{
+		unsigned long long difference;
+		borrow = _subborrow_u64(borrow, load(x + i - 2), load(y + i - 2), &difference);
+		store(z + i - 2, difference);
+	}
+	if (i == 1)
+	{
+		int64_t difference = (int64_t)(uint32_t)x[0] - (uint32_t)y[0] - borrow;
+		z[0] = (int32_t)difference;
+		return difference < 0 ? 1 : 0;
+	}
+	return borrow;
+}
+
+KERNEL_TARGET("bmi2") static int32_t mulsubBmi2(int32_t * q, const int32_t * a, int32_t x, size_t len)
+{
+	uint64_t carry = 0;
+	size_t i = len;
+	for (; i >= 2; i -= 2)
+	{
+		uint64_t high;
+		uint64_t product = mulAdd(load(a + i - 2), (uint32_t)x, carry, 0, high);
+		uint64_t word = load(q + i - 2);
+		store(q + i - 2, word - product);
+		carry = high + (word < product ? 1 : 0);
+	}
+	if (i == 1)
+	{
+		uint64_t product = (uint64_t)(uint32_t)a[0] * (uint32_t)x + carry;
+		uint32_t difference = (uint32_t)q[0] - (uint32_t)product;
+		q[0] = (int32_t)difference;
+		carry = (product >> 32) + (difference > ~(uint32_t)product ? 1 : 0);
+	}
+	return (int32_t)carry;
+}
+
+KERNEL_TARGET("bmi2") static int32_t multiplyAddBmi2(int32_t * x, size_t len, int32_t y, int32_t z)
+{
+	uint64_t carry = (uint32_t)z;
+	size_t i = len;
+	for (; i >= 2; i -= 2)
+	{
+		uint64_t high;
+		store(x + i - 2, mulAdd(load(x + i - 2), (uint32_t)y, carry, 0, high));
+		carry = high;
+	}
+	if (i == 1)
+	{
+		uint64_t product = (uint64_t)(uint32_t)y * (uint32_t)x[0] + carry;
+		x[0] = (int32_t)product;
+		carry = product >> 32;
+	}
+	return (int32_t)carry;
+}
+
+KERNEL_TARGET("avx2") static void bitwiseAvx2(LimbKernels::Bitwise op, int32_t * dst, const int32_t * a, const int32_t * b, size_t len)
+{
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8)
+	{
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i vr;
+		switch (op)
+		{
+		case LimbKernels::AND: vr = _mm256_and_si256(va, vb); break;
+		case LimbKernels::OR: vr = _mm256_or_si256(va, vb); break;
+		case LimbKernels::XOR: vr = _mm256_xor_si256(va, vb); break;
+		default: vr = _mm256_andnot_si256(vb, va); break;
+		}
+		_mm256_storeu_si256((__m256i *)(dst + i), vr);
+	}
+	bitwiseScalar(op, dst + i, a + i, b + i, len - i);
+}
+
+KERNEL_TARGET("avx512f") static void bitwiseAvx512(LimbKernels::Bitwise op, int32_t * dst, const int32_t * a, const int32_t * b, size_t len)
+{
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		__m512i va = _mm512_loadu_si512(a + i);
+		__m512i vb = _mm512_loadu_si512(b + i);
+		__m512i vr;
+		switch (op)
+		{
+		case LimbKernels::AND: vr = _mm512_and_si512(va, vb); break;
+		case LimbKernels::OR: vr = _mm512_or_si512(va, vb); break;
+		case LimbKernels::XOR: vr = _mm512_xor_si512(va, vb); break;
+		default: vr = _mm512_and_si512(va, _mm512_xor_si512(vb, _mm512_set1_epi32(-1))); break;
+		}
+		_mm512_storeu_si512(dst + i, vr);
+	}
+	bitwiseScalar(op, dst + i, a + i, b + i, len - i);
+}
+
+// each vector of results is the words it covers shifted left, joined with
+// the words one further on shifted right
+KERNEL_TARGET("avx2") static void shiftLeftAvx2(int32_t * dst, const int32_t * x, size_t len, int shift)
+{
+	__m128i left = _mm_cvtsi32_si128(shift);
+	__m128i right = _mm_cvtsi32_si128(32 - shift);
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8)
+	{
+		__m256i high = _mm256_loadu_si256((const __m256i *)(x + i));
+		__m256i low = _mm256_loadu_si256((const __m256i *)(x + i + 1));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(_mm256_sll_epi32(high, left), _mm256_srl_epi32(low, right)));
+	}
+	shiftLeftScalar(dst + i, x + i, len - i, shift);
+}
+
+KERNEL_TARGET("avx512f") static void shiftLeftAvx512(int32_t * dst, const int32_t * x, size_t len, int shift)
+{
+	__m128i left = _mm_cvtsi32_si128(shift);
+	__m128i right = _mm_cvtsi32_si128(32 - shift);
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		__m512i high = _mm512_loadu_si512(x + i);
+		__m512i low = _mm512_loadu_si512(x + i + 1);
+		// the zero masked shifts, as GCC warns on the unmasked ones
+		_mm512_storeu_si512(dst + i, _mm512_or_si512(_mm512_maskz_sll_epi32(0xFFFF, high, left), _mm512_maskz_srl_epi32(0xFFFF, low, right)));
+	}
+	shiftLeftScalar(dst + i, x + i, len - i, shift);
+}
+
+KERNEL_TARGET("popcnt") static int popCountPopcnt(const int32_t * x, size_t len)
+{
+	int64_t count = 0;
+	size_t i = 0;
+	for (; i + 2 <= len; i += 2)
+	{
+		uint64_t pair;
+		std::memcpy(&pair, x + i, sizeof(pair));
+		count += _mm_popcnt_u64(pair);
+	}
+	if (i < len)
+	{
+		count += _mm_popcnt_u32((uint32_t)x[i]);
+	}
+	return (int)count;
+}
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, (int)leaf, (int)subleaf);
+	for (int i = 0; i < 4; i++)
+	{
+		regs[i] = (uint32_t)r[i];
+	}
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t xgetbv()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t low, high;
+	__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return ((uint64_t)high << 32) | low;
+#endif
+}
+
+#endif
+
+int LimbKernels::features()
+{
+	return table().features;
+}
+
+std::string LimbKernels::describe()
+{
+	static const char * const NAMES[] = { "bmi2", "avx2", "avx512", "popcnt" };
+	std::string result;
+	for (int i = 0; i < 4; i++)
+	{
+		if (features() & (1 << i))
+		{
+			result += (result.empty() ? "" : " ") + std::string(NAMES[i]);
+		}
+	}
+	return result.empty() ? "scalar" : result;
+}
+
+void LimbKernels::multiply(const int32_t * x, size_t xlen, const int32_t * y, size_t ylen, int32_t * z)
+{
+	if (xlen < WIDE_MULTIPLY_THRESHOLD || ylen < WIDE_MULTIPLY_THRESHOLD)
+	{
+		multiplyScalar(x, xlen, y, ylen, z);
+	}
+	else
+	{
+		table().multiply(x, xlen, y, ylen, z);
+	}
+}
+
+int32_t LimbKernels::add(int32_t * z, const int32_t * x, const int32_t * y, size_t len)
+{
+	return table().add(z, x, y, len);
+}
+
+int32_t LimbKernels::subtract(int32_t * z, const int32_t * x, const int32_t * y, size_t len)
+{
+	return table().subtract(z, x, y, len);
+}
+
+int32_t LimbKernels::mulsub(int32_t * q, const int32_t * a, int32_t x, size_t len)
+{
+	return table().mulsub(q, a, x, len);
+}
+
+int32_t LimbKernels::multiplyAdd(int32_t * x, size_t len, int32_t y, int32_t z)
+{
+	return table().multiplyAdd(x, len, y, z);
+}
+
+void LimbKernels::shiftLeft(int32_t * dst, const int32_t * x, size_t len, int shift)
+{
+	table().shiftLeft(dst, x, len, shift);
+}
+
+void LimbKernels::bitwise(Bitwise op, int32_t * dst, const int32_t * a, const int32_t * b, size_t len)
+{
+	table().bitwise(op, dst, a, b, len);
+}
+
+int LimbKernels::popCount(const int32_t * x, size_t len)
+{
+	return table().popCount(x, len);
+}
+
+const LimbKernels::Table & LimbKernels::table()
+{
+	static const Table selected = select();
+	return selected;
+}
+
+LimbKernels::Table LimbKernels::portable()
+{
+	return Table { 0, multiplyScalar, addScalar, subtractScalar, mulsubScalar, multiplyAddScalar, shiftLeftScalar, bitwiseScalar, popCountScalar };
+}
+
+LimbKernels::Table LimbKernels::select()
+{
+	int allowed = detect();
+	if (const char * env = std::getenv("BIGINTEGER_CPU"))
+	{
+		int named = 0;
+		std::stringstream ss(env);
+		std::string name;
+		while (std::getline(ss, name, ','))
+		{
+			named |= name == "bmi2" ? BMI2 : name == "avx2" ? AVX2 : name == "avx512" ? AVX512 : name == "popcnt" ? POPCNT : 0;
+		}
+		allowed &= named;
+	}
+	Table table = portable();
+	table.features = allowed;
+#if defined(LIMB_KERNELS_X64)
+	if (allowed & BMI2)
+	{
+		table.multiply = multiplyWide;
+		table.add = addBmi2;
+		table.subtract = subtractBmi2;
+		table.mulsub = mulsubBmi2;
+		table.multiplyAdd = multiplyAddBmi2;
+	}
+	if (allowed & AVX512)
+	{
+		table.bitwise = bitwiseAvx512;
+		table.shiftLeft = shiftLeftAvx512;
+	}
+	else if (allowed & AVX2)
+	{
+		table.bitwise = bitwiseAvx2;
+		table.shiftLeft = shiftLeftAvx2;
+	}
+	if (allowed & POPCNT)
+	{
+		table.popCount = popCountPopcnt;
+	}
+#endif
+	return table;
+}
+
+void LimbKernels::multiplyWide(const int32_t * x, size_t xlen, const int32_t * y, size_t ylen, int32_t * z)
+{
+#if defined(LIMB_KERNELS_X64)
+	size_t limbs = xlen / 2 + ylen / 2 + 2;
+	BigInteger::Scratch::Frame frame;
+	// a spare word lets the limbs start on an eight byte boundary
+	int32_t * words = frame.take(4 * limbs + 1);
+	uint64_t * work = (uint64_t *)((uintptr_t)(words + 1) & ~(uintptr_t)7);
+	multiplyBmi2(x, xlen, y, ylen, z, work);
+#else
+	multiplyScalar(x, xlen, y, ylen, z);
+#endif
+}
+
+int LimbKernels::detect()
+{
+	int found = 0;
+#if defined(LIMB_KERNELS_X64)
+	uint32_t leaf0[4], leaf1[4], leaf7[4] = { 0, 0, 0, 0 };
+	cpuid(0, 0, leaf0);
+	cpuid(1, 0, leaf1);
+	if (leaf0[0] >= 7)
+	{
+		cpuid(7, 0, leaf7);
+	}
+	// vector registers are only usable once the operating system saves
+	// their state on a context switch
+	uint64_t saved = (leaf1[2] >> 27 & 1) ? xgetbv() : 0;
+	bool ymm = (saved & 0x6) == 0x6;
+	bool zmm = (saved & 0xE6) == 0xE6;
+	if (leaf7[1] >> 8 & 1)
+	{
+		found |= BMI2;
+	}
+	if (ymm && (leaf7[1] >> 5 & 1))
+	{
+		found |= AVX2;
+	}
+	if (zmm && (leaf7[1] >> 16 & 1))
+	{
+		found |= AVX512;
+	}
+	if (leaf1[2] >> 23 & 1)
+	{
+		found |= POPCNT;
+	}
+#endif
+	return found;
+}
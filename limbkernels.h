@@ -0,0 +1,105 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string>
+
+// Inner loops over magnitudes, each chosen once at startup from the
+// instructions the processor supports. Every kernel has a portable scalar
+// version, which the environment variable BIGINTEGER_CPU=scalar forces; a
+// comma separated list such as BIGINTEGER_CPU=bmi2,popcnt instead limits
+// the detected features to those named
+class LimbKernels
+{
+public:
+	enum Feature
+	{
+		BMI2 = 1 << 0,
+		AVX2 = 1 << 1,
+		AVX512 = 1 << 2,
+		POPCNT = 1 << 3
+	};
+
+	enum Bitwise
+	{
+		AND,
+		OR,
+		XOR,
+		AND_NOT
+	};
+
+	static int features();
+
+	static std::string describe();
+
+	// z = x * y for big-endian magnitudes, z holding xlen + ylen words
+	static void multiply(const int32_t * x, size_t xlen, const int32_t * y, size_t ylen, int32_t * z);
+
+	// z = x + y over len words, returning the carry out of the most
+	// significant; z may be x or y
+	static int32_t add(int32_t * z, const int32_t * x, const int32_t * y, size_t len);
+
+	// z = x - y over len words, returning the borrow out of the most
+	// significant; z may be x or y
+	static int32_t subtract(int32_t * z, const int32_t * x, const int32_t * y, size_t len);
+
+	// q = q - a * x over len words, returning what is left to subtract from
+	// the word above q
+	static int32_t mulsub(int32_t * q, const int32_t * a, int32_t x, size_t len);
+
+	// x = x * y + z in place, returning the word carried out of the top
+	static int32_t multiplyAdd(int32_t * x, size_t len, int32_t y, int32_t z);
+
+	// dst[i] = x[i] << shift | x[i + 1] >>> (32 - shift) for 0 < shift < 32,
+	// reading len + 1 words of x, where dst may be x. A right shift by n is
+	// the same with 32 - n, starting from the word before x
+	static void shiftLeft(int32_t * dst, const int32_t * x, size_t len, int shift);
+
+	// dst[i] = a[i] op b[i], where dst may be a
+	static void bitwise(Bitwise op, int32_t * dst, const int32_t * a, const int32_t * b, size_t len);
+
+	static int popCount(const int32_t * x, size_t len);
+
+private:
+	friend class BigIntegerTuner;
+
+	struct Table
+	{
+		int features;
+
+		void(*multiply)(const int32_t *, size_t, const int32_t *, size_t, int32_t *);
+
+		int32_t(*add)(int32_t *, const int32_t *, const int32_t *, size_t);
+
+		int32_t(*subtract)(int32_t *, const int32_t *, const int32_t *, size_t);
+
+		int32_t(*mulsub)(int32_t *, const int32_t *, int32_t, size_t);
+
+		int32_t(*multiplyAdd)(int32_t *, size_t, int32_t, int32_t);
+
+		void(*shiftLeft)(int32_t *, const int32_t *, size_t, int);
+
+		void(*bitwise)(Bitwise, int32_t *, const int32_t *, const int32_t *, size_t);
+
+		int(*popCount)(const int32_t *, size_t);
+	};
+
+	// built on first use, so static initialisers in other files can
+	// already do arithmetic
+	static const Table & table();
+
+	// the scalar kernels alone
+	static Table portable();
+
+	static Table select();
+
+	// repacks the operands into 64 bit limbs held in the calling thread's
+	// BigInteger scratch words for the BMI2 multiply
+	static void multiplyWide(const int32_t * x, size_t xlen, const int32_t * y, size_t ylen, int32_t * z);
+
+	static int detect();
+};
@@ -0,0 +1,183 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include <atomic>
+#include <inttypes.h>
+#include <vector>
+
+// The words of a BigInteger magnitude, shared by every copy until one of
+// them writes. Reading goes straight to the shared words, and edit() hands
+// them out for writing after taking a private copy if anything else still
+// refers to them, so copying, negating or changing the sign of a value
+// never touches its words. Zero holds no buffer at all
+class Magnitude
+{
+public:
+	typedef std::vector<int32_t>::const_iterator const_iterator;
+
+	Magnitude() :
+		buffer(nullptr)
+	{
+	}
+
+	Magnitude(std::vector<int32_t> words) :
+		buffer(words.empty() ? nullptr : new Buffer(std::move(words)))
+	{
+	}
+
+	Magnitude(const Magnitude & other) :
+		buffer(other.buffer)
+	{
+		if (this->buffer != nullptr)
+		{
+			this->buffer->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	Magnitude(Magnitude && other) noexcept :
+		buffer(other.buffer)
+	{
+		other.buffer = nullptr;
+	}
+
+	~Magnitude()
+	{
+		release();
+	}
+
+	Magnitude & operator=(Magnitude other) noexcept
+	{
+		swap(other);
+		return *this;
+	}
+
+	operator const std::vector<int32_t> &() const
+	{
+		static const std::vector<int32_t> none;
+		return this->buffer == nullptr ? none : this->buffer->words;
+	}
+
+	size_t size() const
+	{
+		return this->buffer == nullptr ? 0 : this->buffer->words.size();
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	const int32_t & operator[](size_t n) const
+	{
+		return this->buffer->words[n];
+	}
+
+	const int32_t & front() const
+	{
+		return this->buffer->words.front();
+	}
+
+	const int32_t & back() const
+	{
+		return this->buffer->words.back();
+	}
+
+	const int32_t * data() const
+	{
+		return this->buffer == nullptr ? nullptr : this->buffer->words.data();
+	}
+
+	const_iterator begin() const
+	{
+		return static_cast<const std::vector<int32_t> &>(*this).begin();
+	}
+
+	const_iterator end() const
+	{
+		return static_cast<const std::vector<int32_t> &>(*this).end();
+	}
+
+	size_t capacity() const
+	{
+		return this->buffer == nullptr ? 0 : this->buffer->words.capacity();
+	}
+
+	// whether any other Magnitude refers to the same words
+	bool shared() const
+	{
+		return this->buffer != nullptr && this->buffer->refs.load(std::memory_order_acquire) != 1;
+	}
+
+	// the words for writing, copied first while they are shared
+	std::vector<int32_t> & edit()
+	{
+		if (this->buffer == nullptr)
+		{
+			this->buffer = new Buffer(std::vector<int32_t>());
+		}
+		else if (shared())
+		{
+			Buffer * copy = new Buffer(this->buffer->words);
+			release();
+			this->buffer = copy;
+		}
+		return this->buffer->words;
+	}
+
+	void clear()
+	{
+		release();
+	}
+
+	void swap(Magnitude & other) noexcept
+	{
+		Buffer * buffer = this->buffer;
+		this->buffer = other.buffer;
+		other.buffer = buffer;
+	}
+
+	friend bool operator==(const Magnitude & lhs, const Magnitude & rhs)
+	{
+		return lhs.buffer == rhs.buffer || static_cast<const std::vector<int32_t> &>(lhs) == static_cast<const std::vector<int32_t> &>(rhs);
+	}
+
+	friend bool operator!=(const Magnitude & lhs, const Magnitude & rhs)
+	{
+		return !(lhs == rhs);
+	}
+
+private:
+	struct Buffer
+	{
+		std::atomic<size_t> refs;
+
+		std::vector<int32_t> words;
+
+		Buffer(std::vector<int32_t> words) :
+			refs(1),
+			words(std::move(words))
+		{
+		}
+	};
+
+	Buffer * buffer;
+
+	void release()
+	{
+		// nothing can take a new reference to words only this Magnitude
+		// holds, so the sole owner frees them without a locked decrement
+		if (this->buffer != nullptr && (this->buffer->refs.load(std::memory_order_acquire) == 1 || this->buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1))
+		{
+			delete this->buffer;
+		}
+		this->buffer = nullptr;
+	}
+};
+
+inline void swap(Magnitude & lhs, Magnitude & rhs) noexcept
+{
+	lhs.swap(rhs);
+}
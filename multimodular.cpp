@@ -0,0 +1,323 @@
+/*
+* Paul Fulham
+*/
+
+#include <algorithm>
+
+#include "multimodular.h"
+
+MultiModular::Basis::Basis(size_t bits)
+{
+	// every prime is above 2^30, so k primes cover 30k bits; two extra bits
+	// leave room for the sign of the symmetric range
+	for (uint32_t candidate = 0x7FFFFFFF; this->primes.size() * 30 < bits + 2; candidate -= 2)
+	{
+		if (isPrime(candidate))
+		{
+			this->primes.push_back(candidate);
+		}
+	}
+	init();
+}
+
+MultiModular::Basis::Basis(const std::vector<uint32_t> & primes) :
+	primes(primes)
+{
+	if (primes.empty())
+	{
+		throw "Empty modular basis";
+	}
+	std::vector<uint32_t> sorted = primes;
+	std::sort(sorted.begin(), sorted.end());
+	if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+	{
+		throw "Duplicate modular basis prime";
+	}
+	for (auto p : primes)
+	{
+		if (p < 3 || p > 0x7FFFFFFF || !isPrime(p))
+		{
+			throw "Illegal modular basis prime";
+		}
+	}
+	init();
+}
+
+size_t MultiModular::Basis::size() const
+{
+	return this->primes.size();
+}
+
+uint32_t MultiModular::Basis::prime(size_t i) const
+{
+	return this->primes[i];
+}
+
+const BigInteger & MultiModular::Basis::modulus() const
+{
+	return this->tree.back()[0];
+}
+
+void MultiModular::Basis::init()
+{
+	size_t count = this->primes.size();
+	std::vector<BigInteger> leaves;
+	std::vector<BigInteger> squares;
+	this->negInverses.resize(count);
+	this->rSquared.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t p = this->primes[i];
+		// Newton's iteration doubles the correct low bits of p^-1 mod 2^32
+		uint32_t inverse = p;
+		for (int k = 0; k < 4; k++)
+		{
+			inverse *= 2 - p * inverse;
+		}
+		this->negInverses[i] = 0 - inverse;
+		uint64_t r = ((uint64_t)1 << 32) % p;
+		this->rSquared[i] = (uint32_t)(r * r % p);
+		leaves.push_back(p);
+		squares.push_back((int64_t)p * p);
+	}
+	this->tree = BigInteger::productTree(leaves);
+	this->halfModulus = modulus() >> 1;
+	// (M / p) mod p comes from M mod p^2, which a remainder tree over the
+	// squared primes produces for every prime at once
+	std::vector<BigInteger> rems = BigInteger::remainders(modulus(), squares);
+	this->crtFactors.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t p = this->primes[i];
+		uint32_t cofactor = (uint32_t)((uint64_t)rems[i].longValue() / p % p);
+		this->crtFactors[i] = inverseWord(cofactor, p);
+	}
+}
+
+bool MultiModular::Basis::isPrime(uint32_t n)
+{
+	if (n < 2 || (n & 1) == 0)
+	{
+		return n == 2;
+	}
+	// bases 2, 7 and 61 make Miller-Rabin deterministic below 2^32
+	uint32_t d = n - 1;
+	int s = 0;
+	while ((d & 1) == 0)
+	{
+		d >>= 1;
+		s++;
+	}
+	for (uint32_t a : { 2u, 7u, 61u })
+	{
+		if (a % n == 0)
+		{
+			continue;
+		}
+		uint64_t x = 1;
+		uint64_t b = a % n;
+		for (uint32_t e = d; e != 0; e >>= 1)
+		{
+			if (e & 1)
+			{
+				x = x * b % n;
+			}
+			b = b * b % n;
+		}
+		if (x == 1 || x == n - 1)
+		{
+			continue;
+		}
+		bool composite = true;
+		for (int r = 1; r < s && composite; r++)
+		{
+			x = x * x % n;
+			composite = x != n - 1;
+		}
+		if (composite)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+MultiModular::MultiModular(std::shared_ptr<const Basis> basis, const BigInteger & value) :
+	base(basis),
+	residues(basis->size(), 0)
+{
+	if (value == 0)
+	{
+		return;
+	}
+	std::vector<BigInteger> rems = BigInteger::remainders(value, basis->tree);
+	for (size_t i = 0; i < this->residues.size(); i++)
+	{
+		uint32_t p = basis->primes[i];
+		int64_t r = rems[i].longValue();
+		uint32_t residue = (uint32_t)(r < 0 ? r + p : r);
+		// residues are kept in Montgomery form, a * 2^32 mod p
+		this->residues[i] = montgomeryMultiply(residue, basis->rSquared[i], p, basis->negInverses[i]);
+	}
+}
+
+MultiModular::MultiModular(std::shared_ptr<const Basis> basis, std::vector<uint32_t> residues) :
+	base(basis),
+	residues(std::move(residues))
+{
+}
+
+MultiModular MultiModular::operator-() const
+{
+	size_t len = this->residues.size();
+	const uint32_t * a = this->residues.data();
+	const uint32_t * p = this->base->primes.data();
+	std::vector<uint32_t> result(len);
+	uint32_t * r = result.data();
+	for (size_t i = 0; i < len; i++)
+	{
+		r[i] = a[i] == 0 ? 0 : p[i] - a[i];
+	}
+	return MultiModular(this->base, std::move(result));
+}
+
+MultiModular MultiModular::operator+(const MultiModular & rhs) const
+{
+	checkBasis(rhs);
+	size_t len = this->residues.size();
+	const uint32_t * a = this->residues.data();
+	const uint32_t * b = rhs.residues.data();
+	const uint32_t * p = this->base->primes.data();
+	std::vector<uint32_t> result(len);
+	uint32_t * r = result.data();
+	// primes are below 2^31, so the sum cannot wrap
+	for (size_t i = 0; i < len; i++)
+	{
+		uint32_t sum = a[i] + b[i];
+		r[i] = sum >= p[i] ? sum - p[i] : sum;
+	}
+	return MultiModular(this->base, std::move(result));
+}
+
+MultiModular MultiModular::operator-(const MultiModular & rhs) const
+{
+	checkBasis(rhs);
+	size_t len = this->residues.size();
+	const uint32_t * a = this->residues.data();
+	const uint32_t * b = rhs.residues.data();
+	const uint32_t * p = this->base->primes.data();
+	std::vector<uint32_t> result(len);
+	uint32_t * r = result.data();
+	for (size_t i = 0; i < len; i++)
+	{
+		uint32_t difference = a[i] - b[i];
+		r[i] = a[i] < b[i] ? difference + p[i] : difference;
+	}
+	return MultiModular(this->base, std::move(result));
+}
+
+MultiModular MultiModular::operator*(const MultiModular & rhs) const
+{
+	checkBasis(rhs);
+	size_t len = this->residues.size();
+	const uint32_t * a = this->residues.data();
+	const uint32_t * b = rhs.residues.data();
+	const uint32_t * p = this->base->primes.data();
+	const uint32_t * n = this->base->negInverses.data();
+	std::vector<uint32_t> result(len);
+	uint32_t * r = result.data();
+	for (size_t i = 0; i < len; i++)
+	{
+		r[i] = montgomeryMultiply(a[i], b[i], p[i], n[i]);
+	}
+	return MultiModular(this->base, std::move(result));
+}
+
+bool MultiModular::operator==(const MultiModular & rhs) const
+{
+	return this->base == rhs.base && this->residues == rhs.residues;
+}
+
+bool MultiModular::operator!=(const MultiModular & rhs) const
+{
+	return !(*this == rhs);
+}
+
+uint32_t MultiModular::residue(size_t i) const
+{
+	return montgomeryMultiply(this->residues[i], 1, this->base->primes[i], this->base->negInverses[i]);
+}
+
+const std::shared_ptr<const MultiModular::Basis> & MultiModular::basis() const
+{
+	return this->base;
+}
+
+BigInteger MultiModular::toBigInteger() const
+{
+	const Basis & basis = *this->base;
+	// x = sum of s_i * M / p_i with s_i = r_i * (M / p_i)^-1 mod p_i. Each
+	// node of the product tree combines its children as
+	// left * right.product + right * left.product, so only the root ever
+	// multiplies full size operands
+	std::vector<BigInteger> sums(this->residues.size());
+	for (size_t i = 0; i < sums.size(); i++)
+	{
+		// the Montgomery product of a * 2^32 and c is already a * c mod p
+		sums[i] = (int64_t)montgomeryMultiply(this->residues[i], basis.crtFactors[i], basis.primes[i], basis.negInverses[i]);
+	}
+	for (size_t depth = 0; depth + 1 < basis.tree.size(); depth++)
+	{
+		const std::vector<BigInteger> & level = basis.tree[depth];
+		std::vector<BigInteger> next((sums.size() + 1) / 2);
+		BigInteger::forEachNode(next.size(), BigInteger::levelLength(level), [&](size_t i)
+		{
+			if (2 * i + 1 < sums.size())
+			{
+				next[i] = sums[2 * i] * level[2 * i + 1] + sums[2 * i + 1] * level[2 * i];
+			}
+			else
+			{
+				next[i] = sums[2 * i];
+			}
+		});
+		sums = std::move(next);
+	}
+	BigInteger x = sums[0] % basis.modulus();
+	return x > basis.halfModulus ? x - basis.modulus() : x;
+}
+
+void MultiModular::checkBasis(const MultiModular & rhs) const
+{
+	if (this->base != rhs.base)
+	{
+		throw "Mismatched modular basis";
+	}
+}
+
+uint32_t MultiModular::montgomeryMultiply(uint32_t a, uint32_t b, uint32_t p, uint32_t negInverse)
+{
+	uint64_t t = (uint64_t)a * b;
+	uint32_t m = (uint32_t)t * negInverse;
+	uint32_t u = (uint32_t)((t + (uint64_t)m * p) >> 32);
+	return u >= p ? u - p : u;
+}
+
+uint32_t MultiModular::inverseWord(uint32_t a, uint32_t p)
+{
+	int64_t t = 0, newT = 1;
+	int64_t r = p, newR = a;
+	while (newR != 0)
+	{
+		int64_t q = r / newR;
+		std::swap(t, newT);
+		newT -= q * t;
+		std::swap(r, newR);
+		newR -= q * r;
+	}
+	if (r != 1)
+	{
+		throw "BigInteger not invertible";
+	}
+	return (uint32_t)(t < 0 ? t + p : t);
+}
@@ -0,0 +1,88 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include <memory>
+
+#include "biginteger.h"
+
+// An integer held as its residues modulo a basis of distinct odd primes
+// below 2^31, so addition, subtraction and multiplication are a loop of
+// independent word operations with no carries between them. A basis made
+// from a bit count picks primes above 2^30 until their product M covers
+// that many bits and a sign. Values must stay within half of M in size,
+// or they wrap without notice, and both operands must share one basis
+// object. Residues are kept in Montgomery form. toBigInteger rebuilds the
+// value by the Chinese remainder theorem up the basis's product tree,
+// reduced into the symmetric range about zero
+class MultiModular
+{
+public:
+	class Basis
+	{
+	public:
+		Basis(size_t bits);
+
+		Basis(const std::vector<uint32_t> & primes);
+
+		size_t size() const;
+
+		uint32_t prime(size_t i) const;
+
+		const BigInteger & modulus() const;
+
+	private:
+		friend class MultiModular;
+
+		std::vector<uint32_t> primes;
+
+		std::vector<uint32_t> negInverses;
+
+		std::vector<uint32_t> rSquared;
+
+		std::vector<uint32_t> crtFactors;
+
+		std::vector<std::vector<BigInteger>> tree;
+
+		BigInteger halfModulus;
+
+		void init();
+
+		static bool isPrime(uint32_t n);
+	};
+
+	MultiModular(std::shared_ptr<const Basis> basis, const BigInteger & value = 0);
+
+	MultiModular operator-() const;
+
+	MultiModular operator+(const MultiModular & rhs) const;
+
+	MultiModular operator-(const MultiModular & rhs) const;
+
+	MultiModular operator*(const MultiModular & rhs) const;
+
+	bool operator==(const MultiModular & rhs) const;
+
+	bool operator!=(const MultiModular & rhs) const;
+
+	uint32_t residue(size_t i) const;
+
+	const std::shared_ptr<const Basis> & basis() const;
+
+	BigInteger toBigInteger() const;
+
+private:
+	std::shared_ptr<const Basis> base;
+
+	std::vector<uint32_t> residues;
+
+	MultiModular(std::shared_ptr<const Basis> basis, std::vector<uint32_t> residues);
+
+	void checkBasis(const MultiModular & rhs) const;
+
+	static uint32_t montgomeryMultiply(uint32_t a, uint32_t b, uint32_t p, uint32_t negInverse);
+
+	static uint32_t inverseWord(uint32_t a, uint32_t p);
+};
@@ -0,0 +1,292 @@
+/*
+* Paul Fulham
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "threadpool.h"
+
+struct ThreadPool::Task
+{
+	enum State
+	{
+		QUEUED,
+		RUNNING,
+		DONE
+	};
+
+	std::function<void()> body;
+
+	std::atomic<int> state;
+
+	std::exception_ptr error;
+
+	std::mutex lock;
+
+	std::condition_variable finished;
+
+	Task(const std::function<void()> & body) :
+		body(body),
+		state(QUEUED)
+	{
+	}
+
+	// whoever claims a task runs it, so a task the pool has not reached yet
+	// is simply run by the thread waiting for it
+	bool claim()
+	{
+		int expected = QUEUED;
+		return this->state.compare_exchange_strong(expected, RUNNING);
+	}
+
+	void run()
+	{
+		try
+		{
+			this->body();
+		}
+		catch (...)
+		{
+			this->error = std::current_exception();
+		}
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			this->state = DONE;
+		}
+		this->finished.notify_all();
+		ThreadPool::release(1);
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> guard(this->lock);
+		this->finished.wait(guard, [this] { return this->state == DONE; });
+	}
+};
+
+thread_local ThreadPool * ThreadPool::current = nullptr;
+
+thread_local size_t ThreadPool::currentIndex = 0;
+
+thread_local int ThreadPool::occupancy = 0;
+
+static std::atomic<ptrdiff_t> & budget()
+{
+	static std::atomic<ptrdiff_t> available((ptrdiff_t)std::max(1u, std::thread::hardware_concurrency()));
+	return available;
+}
+
+ThreadPool::Occupant::Occupant() :
+	counted(current == nullptr && occupancy++ == 0)
+{
+	// workers already hold the share their task reserved, and nested
+	// operations on one thread count once
+	if (this->counted)
+	{
+		budget()--;
+	}
+}
+
+ThreadPool::Occupant::~Occupant()
+{
+	if (current == nullptr)
+	{
+		occupancy--;
+	}
+	if (this->counted)
+	{
+		budget()++;
+	}
+}
+
+ThreadPool::ThreadPool(size_t threads) :
+	queued(0),
+	nextWorker(0),
+	stopping(false)
+{
+	if (threads == 0)
+	{
+		throw "Empty thread pool";
+	}
+	for (size_t i = 0; i < threads; i++)
+	{
+		this->workers.emplace_back(new Worker());
+	}
+	for (size_t i = 0; i < threads; i++)
+	{
+		this->threads.emplace_back(&ThreadPool::work, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(this->sleepLock);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for (auto & thread : this->threads)
+	{
+		thread.join();
+	}
+}
+
+size_t ThreadPool::size() const
+{
+	return this->workers.size();
+}
+
+void ThreadPool::invoke(const std::vector<std::function<void()>> & tasks)
+{
+	if (tasks.empty())
+	{
+		return;
+	}
+	Occupant occupant;
+	size_t granted = reserve(std::min(tasks.size() - 1, this->workers.size()));
+	std::vector<std::shared_ptr<Task>> forked;
+	for (size_t i = 0; i < granted; i++)
+	{
+		forked.push_back(std::make_shared<Task>(tasks[tasks.size() - 1 - i]));
+		push(forked.back());
+	}
+	std::exception_ptr error;
+	for (size_t i = 0; i < tasks.size() - granted; i++)
+	{
+		try
+		{
+			tasks[i]();
+		}
+		catch (...)
+		{
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	}
+	// joining newest first takes back what no worker has stolen yet
+	for (size_t i = forked.size(); i-- > 0; )
+	{
+		Task & task = *forked[i];
+		if (task.claim())
+		{
+			task.run();
+		}
+		else
+		{
+			task.wait();
+		}
+		if (task.error && !error)
+		{
+			error = task.error;
+		}
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+size_t ThreadPool::reserve(size_t wanted)
+{
+	std::atomic<ptrdiff_t> & available = budget();
+	ptrdiff_t seen = available.load();
+	ptrdiff_t granted;
+	do
+	{
+		granted = std::min((ptrdiff_t)wanted, std::max<ptrdiff_t>(seen, 0));
+	}
+	while (granted > 0 && !available.compare_exchange_weak(seen, seen - granted));
+	return (size_t)granted;
+}
+
+void ThreadPool::release(size_t count)
+{
+	budget() += (ptrdiff_t)count;
+}
+
+size_t ThreadPool::defaultSize()
+{
+	// the thread that calls invoke works too
+	unsigned hardware = std::thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 1;
+}
+
+void ThreadPool::push(const std::shared_ptr<Task> & task)
+{
+	size_t index;
+	if (current == this)
+	{
+		index = currentIndex;
+	}
+	else
+	{
+		std::lock_guard<std::mutex> guard(this->sleepLock);
+		index = this->nextWorker++ % this->workers.size();
+	}
+	{
+		std::lock_guard<std::mutex> guard(this->workers[index]->lock);
+		this->workers[index]->tasks.push_back(task);
+	}
+	{
+		std::lock_guard<std::mutex> guard(this->sleepLock);
+		this->queued++;
+	}
+	this->wake.notify_one();
+}
+
+std::shared_ptr<ThreadPool::Task> ThreadPool::take(size_t index)
+{
+	std::shared_ptr<Task> task;
+	for (size_t k = 0; k < this->workers.size() && !task; k++)
+	{
+		Worker & worker = *this->workers[(index + k) % this->workers.size()];
+		std::lock_guard<std::mutex> guard(worker.lock);
+		if (worker.tasks.empty())
+		{
+			continue;
+		}
+		if (k == 0)
+		{
+			task = worker.tasks.back();
+			worker.tasks.pop_back();
+		}
+		else
+		{
+			task = worker.tasks.front();
+			worker.tasks.pop_front();
+		}
+	}
+	if (task)
+	{
+		std::lock_guard<std::mutex> guard(this->sleepLock);
+		this->queued--;
+	}
+	return task;
+}
+
+void ThreadPool::work(size_t index)
+{
+	current = this;
+	currentIndex = index;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> guard(this->sleepLock);
+			this->wake.wait(guard, [this] { return this->stopping || this->queued > 0; });
+			if (this->stopping && this->queued == 0)
+			{
+				return;
+			}
+		}
+		std::shared_ptr<Task> task = take(index);
+		// a task its owner already claimed is left behind as an empty entry
+		if (task && task->claim())
+		{
+			task->run();
+		}
+	}
+}
@@ -0,0 +1,88 @@
+/*
+* Paul Fulham
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of workers, each with its own deque of tasks. A worker runs
+// its newest task first and steals the oldest from the others when its own
+// deque is empty. Work only reaches the workers while the process-wide
+// budget of hardware threads has room, and each thread busy with parallel
+// BigInteger work holds a share of that budget, so a program that is
+// already running many computations at once gets no extra threads; tasks
+// the pool cannot take run on the calling thread
+class ThreadPool
+{
+public:
+	ThreadPool(size_t threads = defaultSize());
+
+	~ThreadPool();
+
+	size_t size() const;
+
+	// runs every task and returns once all have finished, rethrowing the
+	// first exception any of them threw
+	void invoke(const std::vector<std::function<void()>> & tasks);
+
+	static size_t defaultSize();
+
+private:
+	class Occupant
+	{
+	public:
+		Occupant();
+
+		~Occupant();
+
+	private:
+		bool counted;
+	};
+
+	// takes up to wanted threads from the budget and returns how many it got
+	static size_t reserve(size_t wanted);
+
+	static void release(size_t count);
+
+	struct Task;
+
+	struct Worker
+	{
+		std::mutex lock;
+
+		std::deque<std::shared_ptr<Task>> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::vector<std::thread> threads;
+
+	std::mutex sleepLock;
+
+	std::condition_variable wake;
+
+	size_t queued;
+
+	size_t nextWorker;
+
+	bool stopping;
+
+	void push(const std::shared_ptr<Task> & task);
+
+	std::shared_ptr<Task> take(size_t index);
+
+	void work(size_t index);
+
+	static thread_local ThreadPool * current;
+
+	static thread_local size_t currentIndex;
+
+	static thread_local int occupancy;
+};